@@ -0,0 +1,6 @@
+option(ENABLE_LOCK_PROFILING "Record wait/hold time and spins of camus::ProfiledLock" OFF)
+message(STATUS "ENABLE_LOCK_PROFILING: ${ENABLE_LOCK_PROFILING}")
+
+if(ENABLE_LOCK_PROFILING)
+  add_definitions(-DCAMUS_LOCK_PROFILING)
+endif()
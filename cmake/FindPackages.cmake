@@ -1,4 +1,5 @@
 find_package(GTest)
+find_package(benchmark)
 find_package(Boost)
 find_package(magic_enum)
 find_package(robin_hood)
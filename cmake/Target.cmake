@@ -51,3 +51,15 @@ macro(target_add_test NAME)
   set_target_properties(${NAME} PROPERTIES RUNTIME_OUTPUT_DIRECTORY "${CMAKE_BINARY_DIR}/tests")
 endmacro()
 
+
+macro(target_add_bench NAME)
+  add_executable(${NAME} ${ARGN})
+  target_include_directories(${NAME}
+    PUBLIC
+      $<BUILD_INTERFACE:${PROJECT_SOURCE_DIR}/src>
+      ${PROJECT_SOURCE_DIR}
+      ${PROJECT_BINARY_DIR}/src
+      ${PROJECT_BINARY_DIR}
+  )
+  set_target_properties(${NAME} PROPERTIES RUNTIME_OUTPUT_DIRECTORY "${CMAKE_BINARY_DIR}/bench")
+endmacro()
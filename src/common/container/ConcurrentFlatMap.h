@@ -0,0 +1,260 @@
+#pragma once
+
+#include <common/spinlock/rw_spinlock.h>
+#include <robin_hood.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace camus {
+
+namespace detail::flat_map {
+// robin_hood::hash, made transparent for std::string keys, so that they can be looked up by std::string_view
+// or const char * without building a std::string.
+template <typename K>
+struct Hash : robin_hood::hash<K> {};
+
+template <>
+struct Hash<std::string> {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return robin_hood::hash<std::string_view>()(s); }
+};
+
+template <typename L>
+concept SharedLockable = requires(L & l) {
+    l.lock_shared();
+    l.unlock_shared();
+};
+
+// written under the shard lock, read without it.
+struct Counter {
+    void add(int64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+    std::atomic<int64_t> value = 0;
+};
+} // namespace detail::flat_map
+
+struct ConcurrentFlatMapStats {
+    int64_t size = 0;
+    // new keys, by insert, insertOrAssign or upsert
+    int64_t inserts = 0;
+    // existing values changed by insertOrAssign or upsert
+    int64_t updates = 0;
+    int64_t erases = 0;
+
+    ConcurrentFlatMapStats & operator+=(const ConcurrentFlatMapStats & other) {
+        size += other.size;
+        inserts += other.inserts;
+        updates += other.updates;
+        erases += other.erases;
+        return *this;
+    }
+};
+
+// Hash map split into shards by the hash of the key, each a robin_hood::unordered_flat_map behind its own
+// Lock. Threads touching different keys mostly take different locks, and when Lock has lock_shared (e.g.
+// RwSpinLock, BrSpinLock), lookups of the same shard run together. Any lock of common/spinlock fits.
+//
+//     ConcurrentFlatMap<std::string, Session> sessions;
+//     sessions.upsert(id, [&](Session & s) { s.touch(now); });
+//     sessions.visit(std::string_view(id), [&](const Session & s) { reply(s.user); });
+//
+// Lookups are heterogeneous when Hash and KeyEqual are transparent, which the defaults are for std::string.
+// Callbacks run under the shard lock, so they should be short and must not call back into the map. Values
+// move when a shard grows, don't keep references to them outside a callback.
+//
+// size() and stats() read per-shard counters without taking any lock, so they are cheap to poll, but only
+// approximate while the map is changing.
+template <
+    typename K,
+    typename V,
+    typename Lock = RwSpinLock,
+    typename Hash = detail::flat_map::Hash<K>,
+    typename KeyEqual = std::equal_to<>>
+class ConcurrentFlatMap {
+    using Map = robin_hood::unordered_flat_map<K, V, Hash, KeyEqual>;
+
+    struct alignas(64) Shard {
+        Lock lock;
+        Map map;
+        // on its own line, so that polling stats doesn't bounce the lock.
+        alignas(64) struct {
+            detail::flat_map::Counter size;
+            detail::flat_map::Counter inserts;
+            detail::flat_map::Counter updates;
+            detail::flat_map::Counter erases;
+        } counters;
+    };
+
+public:
+    // shardCount must be a power of 2.
+    explicit ConcurrentFlatMap(size_t shardCount = 64)
+        : m_mask(shardCount - 1)
+        , m_shards(std::make_unique<Shard[]>(shardCount)) {
+        assert(shardCount > 0 && (shardCount & (shardCount - 1)) == 0);
+    }
+
+    ConcurrentFlatMap(const ConcurrentFlatMap &) = delete;
+    ConcurrentFlatMap & operator=(const ConcurrentFlatMap &) = delete;
+
+    // Returns a copy of the value, std::nullopt if key is missing.
+    template <typename Q>
+    std::optional<V> find(const Q & key) const {
+        std::optional<V> res;
+        visit(key, [&](const V & v) { res = v; });
+        return res;
+    }
+
+    template <typename Q>
+    bool contains(const Q & key) const {
+        return visit(key, [](const V &) {});
+    }
+
+    // Calls fn(const V &) under the shard lock, shared if Lock allows. Returns false if key is missing.
+    template <typename Q, typename F>
+    bool visit(const Q & key, F && fn) const {
+        auto & shard = shardOf(key);
+        auto lock = lockShared(shard);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end())
+            return false;
+        std::forward<F>(fn)(std::as_const(it->second));
+        return true;
+    }
+
+    // Calls fn(V &) under the shard lock, on a value-initialized V if key is missing. Returns true if it was
+    // inserted. A std::string is only built from key when inserting.
+    template <typename Q, typename F>
+    requires std::default_initializable<V>
+    bool upsert(Q && key, F && fn) {
+        auto & shard = shardOf(key);
+        std::unique_lock lock(shard.lock);
+        auto it = shard.map.find(key);
+        auto inserted = it == shard.map.end();
+        if (inserted) {
+            it = shard.map.try_emplace(K(std::forward<Q>(key))).first;
+            shard.counters.size.add(1);
+            shard.counters.inserts.add(1);
+        } else {
+            shard.counters.updates.add(1);
+        }
+        std::forward<F>(fn)(it->second);
+        return inserted;
+    }
+
+    // Returns false and leaves the map as is if key exists.
+    bool insert(K key, V value) {
+        auto & shard = shardOf(key);
+        std::unique_lock lock(shard.lock);
+        if (!shard.map.try_emplace(std::move(key), std::move(value)).second)
+            return false;
+        shard.counters.size.add(1);
+        shard.counters.inserts.add(1);
+        return true;
+    }
+
+    // Returns true if key was inserted, false if its value was replaced.
+    bool insertOrAssign(K key, V value) {
+        auto & shard = shardOf(key);
+        std::unique_lock lock(shard.lock);
+        auto inserted = shard.map.insert_or_assign(std::move(key), std::move(value)).second;
+        if (inserted) {
+            shard.counters.size.add(1);
+            shard.counters.inserts.add(1);
+        } else {
+            shard.counters.updates.add(1);
+        }
+        return inserted;
+    }
+
+    template <typename Q>
+    bool erase(const Q & key) {
+        auto & shard = shardOf(key);
+        std::unique_lock lock(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end())
+            return false;
+        shard.map.erase(it);
+        shard.counters.size.add(-1);
+        shard.counters.erases.add(1);
+        return true;
+    }
+
+    // Calls fn(const K &, const V &) on every entry, one shard at a time under its lock. Not a snapshot:
+    // entries changed in shards not yet visited are seen as changed.
+    template <typename F>
+    void forEach(F && fn) const {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            auto lock = lockShared(m_shards[i]);
+            for (auto & [k, v] : m_shards[i].map)
+                fn(k, std::as_const(v));
+        }
+    }
+
+    void clear() {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            auto & shard = m_shards[i];
+            std::unique_lock lock(shard.lock);
+            shard.counters.erases.add(static_cast<int64_t>(shard.map.size()));
+            shard.counters.size.add(-static_cast<int64_t>(shard.map.size()));
+            shard.map.clear();
+        }
+    }
+
+    size_t size() const {
+        int64_t res = 0;
+        for (size_t i = 0; i <= m_mask; ++i)
+            res += m_shards[i].counters.size.get();
+        return static_cast<size_t>(std::max<int64_t>(res, 0));
+    }
+
+    size_t shardCount() const { return m_mask + 1; }
+
+    // Without locking, see ConcurrentFlatMapStats.
+    ConcurrentFlatMapStats shardStats(size_t shard) const {
+        auto & c = m_shards[shard].counters;
+        return {c.size.get(), c.inserts.get(), c.updates.get(), c.erases.get()};
+    }
+
+    ConcurrentFlatMapStats stats() const {
+        ConcurrentFlatMapStats res;
+        for (size_t i = 0; i <= m_mask; ++i)
+            res += shardStats(i);
+        return res;
+    }
+
+private:
+    template <typename Q>
+    Shard & shardOf(const Q & key) const {
+        // robin_hood takes buckets from the low bits of its own remix, shards take the high bits of another.
+        auto h = static_cast<uint64_t>(m_hash(key)) * 0x9e3779b97f4a7c15ULL;
+        return m_shards[(h >> 32) & m_mask];
+    }
+
+    static auto lockShared(Shard & shard) {
+        if constexpr (detail::flat_map::SharedLockable<Lock>)
+            return std::shared_lock(shard.lock);
+        else
+            return std::unique_lock(shard.lock);
+    }
+
+    const size_t m_mask;
+    std::unique_ptr<Shard[]> m_shards;
+    [[no_unique_address]] Hash m_hash;
+};
+
+} // namespace camus
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <common/scheduler/Scheduler.h>
+
+#include <boost/asio/execution.hpp>
+#include <boost/asio/execution_context.hpp>
+
+#include <utility>
+
+namespace camus {
+
+// Runs asio handlers and coroutines on a `Scheduler`. It outlives the executors got from it.
+//
+//     AsioSchedulerContext ctx(scheduler);
+//     boost::asio::post(ctx.get_executor(), [] { ... });
+//     boost::asio::co_spawn(ctx.get_executor(), task(), boost::asio::detached);
+class AsioSchedulerContext : public boost::asio::execution_context {
+public:
+    class executor_type {
+    public:
+        explicit executor_type(AsioSchedulerContext & ctx) noexcept
+            : m_context(&ctx) {}
+
+        AsioSchedulerContext & query(boost::asio::execution::context_t) const noexcept { return *m_context; }
+
+        // never runs f inline
+        static constexpr auto query(boost::asio::execution::blocking_t) noexcept {
+            return boost::asio::execution::blocking.never;
+        }
+
+        executor_type require(boost::asio::execution::blocking_t::never_t) const noexcept { return *this; }
+
+        template <typename F>
+        void execute(F && f) const {
+            m_context->m_scheduler.post(std::forward<F>(f));
+        }
+
+        bool operator==(const executor_type & other) const noexcept { return m_context == other.m_context; }
+        bool operator!=(const executor_type & other) const noexcept { return !(*this == other); }
+
+    private:
+        AsioSchedulerContext * m_context;
+    };
+
+    explicit AsioSchedulerContext(Scheduler & scheduler)
+        : m_scheduler(scheduler) {}
+
+    executor_type get_executor() noexcept { return executor_type(*this); }
+
+private:
+    Scheduler & m_scheduler;
+};
+
+} // namespace camus
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing deque based on the following paper:
+// https://fzn.fr/readings/ppopp13.pdf
+//
+// The owner pushes and pops at the bottom, thieves steal from the top.
+
+namespace camus {
+
+template <typename T>
+class ChaseLevDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "slots are read racily by thieves");
+
+    struct Array {
+        explicit Array(int64_t capacity_)
+            : capacity(capacity_)
+            , slots(new std::atomic<T>[capacity_]) {}
+
+        T get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T v) { slots[i & (capacity - 1)].store(v, std::memory_order_relaxed); }
+
+        const int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+public:
+    enum class StealResult {
+        SUCCESS,
+        EMPTY,
+        // lost the race with the owner or another thief.
+        ABORT,
+    };
+
+    // capacity must be a power of 2, the deque grows when it is full.
+    explicit ChaseLevDeque(int64_t capacity = 256) {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+        auto a = std::make_unique<Array>(capacity);
+        m_array.store(a.get(), std::memory_order_relaxed);
+        m_arrays.push_back(std::move(a));
+    }
+
+    ChaseLevDeque(const ChaseLevDeque &) = delete;
+    ChaseLevDeque & operator=(const ChaseLevDeque &) = delete;
+
+    // Owner only.
+    void push(T v) {
+        auto b = m_bottom.load(std::memory_order_relaxed);
+        auto t = m_top.load(std::memory_order_acquire);
+        auto * a = m_array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow(a, t, b);
+        a->put(b, v);
+        // a release store instead of the release fence of the paper, same on x86 and visible to tsan.
+        m_bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only.
+    std::optional<T> pop() {
+        auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+        auto * a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = m_top.load(std::memory_order_relaxed);
+        std::optional<T> res;
+        if (t <= b) {
+            res = a->get(b);
+            if (t == b) {
+                // the last one, race with thieves.
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    res.reset();
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+    // Any thread.
+    StealResult steal(T & out) {
+        auto t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return StealResult::EMPTY;
+        // consume in the paper, which compilers promote to acquire anyway.
+        auto * a = m_array.load(std::memory_order_acquire);
+        auto v = a->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return StealResult::ABORT;
+        out = v;
+        return StealResult::SUCCESS;
+    }
+
+    // Approximate when called by a thief.
+    bool empty() const { return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed); }
+
+private:
+    // Old arrays may still be read by thieves, so they are kept until destruction.
+    Array * grow(Array * a, int64_t t, int64_t b) {
+        auto bigger = std::make_unique<Array>(a->capacity * 2);
+        for (auto i = t; i < b; ++i)
+            bigger->put(i, a->get(i));
+        auto * res = bigger.get();
+        m_arrays.push_back(std::move(bigger));
+        m_array.store(res, std::memory_order_release);
+        return res;
+    }
+
+    alignas(64) std::atomic<int64_t> m_top = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+    std::atomic<Array *> m_array;
+    // owned by the owner thread
+    std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+} // namespace camus
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <common/scheduler/Scheduler.h>
+#include <folly/Executor.h>
+
+#include <utility>
+
+namespace camus {
+
+// Runs folly tasks on a `Scheduler`, e.g. `std::move(task).scheduleOn(&executor)`. Keep-alive tokens are
+// not counted, the scheduler must outlive the work scheduled on it.
+class FollyExecutor : public folly::Executor {
+public:
+    explicit FollyExecutor(Scheduler & scheduler)
+        : m_scheduler(scheduler) {}
+
+    void add(folly::Func f) override { m_scheduler.post(std::move(f)); }
+
+private:
+    Scheduler & m_scheduler;
+};
+
+} // namespace camus
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <common/scheduler/ChaseLevDeque.h>
+#include <common/utils/Futex.h>
+#include <common/waitfree/WfQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace camus {
+namespace detail::scheduler {
+
+struct Task {
+    virtual ~Task() = default;
+    virtual void run() = 0;
+};
+
+template <typename F>
+struct TaskImpl final : Task {
+    explicit TaskImpl(F && f_)
+        : f(std::move(f_)) {}
+    explicit TaskImpl(const F & f_)
+        : f(f_) {}
+
+    void run() override { f(); }
+
+    F f;
+};
+
+} // namespace detail::scheduler
+
+// Work-stealing scheduler. Each worker owns a Chase-Lev deque, tasks posted by a worker go to its own deque
+// and run LIFO, tasks posted by other threads go to a global injection queue, which is a `WfQueue`. An idle
+// worker looks at its deque, then the injection queue, then steals from others, and parks on a futex at
+// last. Posting only wakes a worker when some are parked.
+//
+//     Scheduler s(4);
+//     s.post([] { ... });
+//
+// See AsioExecutor.h and FollyExecutor.h for using it from asio and folly::coro.
+class Scheduler {
+    using Task = detail::scheduler::Task;
+    using InjectionQueue = WfQueue<std::unique_ptr<Task>>;
+
+    // how long an idle worker parks before looking around again.
+    static constexpr auto PARK_TIMEOUT = std::chrono::seconds(1);
+
+    struct Worker {
+        explicit Worker(Scheduler & s, uint64_t seed)
+            : scheduler(s)
+            , rng(seed) {}
+
+        Scheduler & scheduler;
+        ChaseLevDeque<Task *> deque;
+        std::optional<InjectionQueue::Handle> injection;
+        // for picking victims
+        uint64_t rng;
+        std::thread thread;
+    };
+
+    // Handle of a non-worker thread to the injection queue. Shares the queue, so that a thread may outlive
+    // the scheduler it posted to.
+    struct Injector {
+        explicit Injector(std::shared_ptr<InjectionQueue> q)
+            : queue(std::move(q))
+            , handle(*queue) {}
+
+        std::shared_ptr<InjectionQueue> queue;
+        InjectionQueue::Handle handle;
+    };
+
+public:
+    explicit Scheduler(size_t workerCount = std::thread::hardware_concurrency())
+        : m_injection(std::make_shared<InjectionQueue>()) {
+        workerCount = std::max<size_t>(workerCount, 1);
+        for (size_t i = 0; i < workerCount; ++i)
+            m_workers.push_back(std::make_unique<Worker>(*this, i * 0x9E3779B97F4A7C15ull + 1));
+        for (auto & w : m_workers)
+            w->thread = std::thread([this, w = w.get()] { run(*w); });
+    }
+
+    ~Scheduler() { stop(); }
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler & operator=(const Scheduler &) = delete;
+
+    // f is called once on some worker.
+    template <typename F>
+    void post(F && f) {
+        submit(new detail::scheduler::TaskImpl<std::decay_t<F>>(std::forward<F>(f)));
+    }
+
+    // Waits for posted tasks, including those they post, then joins workers. Tasks posted from other
+    // threads after that are dropped. Must not be called by a worker.
+    void stop() {
+        assert(!inWorker());
+        m_stopping.store(true);
+        m_wakeups.fetch_add(1);
+        futexWakeAll(&m_wakeups);
+        for (auto & w : m_workers) {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+
+    bool inWorker() const { return tWorker != nullptr && &tWorker->scheduler == this; }
+
+    size_t workerCount() const { return m_workers.size(); }
+
+private:
+    void submit(Task * t) {
+        if (inWorker())
+            tWorker->deque.push(t);
+        else
+            injector().enqueue(std::unique_ptr<Task>(t));
+        wakeOne();
+    }
+
+    InjectionQueue::Handle & injector() {
+        thread_local std::vector<std::unique_ptr<Injector>> injectors;
+        for (auto & i : injectors) {
+            if (i->queue == m_injection)
+                return i->handle;
+        }
+        // drop handles of destroyed schedulers
+        std::erase_if(injectors, [](auto & i) { return i->queue.use_count() == 1; });
+        return injectors.emplace_back(std::make_unique<Injector>(m_injection))->handle;
+    }
+
+    // The task is published before loading m_sleepers, while a worker increases m_sleepers before its last
+    // look for tasks. So either the worker sees the task, or we see the worker.
+    void wakeOne() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) == 0)
+            return;
+        m_wakeups.fetch_add(1);
+        futexWake(&m_wakeups, 1);
+    }
+
+    Task * steal(Worker & w) {
+        // xorshift
+        w.rng ^= w.rng << 13;
+        w.rng ^= w.rng >> 7;
+        w.rng ^= w.rng << 17;
+        auto n = m_workers.size();
+        auto start = w.rng % n;
+        for (size_t i = 0; i < n; ++i) {
+            auto & victim = *m_workers[(start + i) % n];
+            if (&victim == &w)
+                continue;
+            Task * t = nullptr;
+            for (;;) {
+                auto r = victim.deque.steal(t);
+                if (r == ChaseLevDeque<Task *>::StealResult::SUCCESS)
+                    return t;
+                if (r == ChaseLevDeque<Task *>::StealResult::EMPTY)
+                    break;
+            }
+        }
+        return nullptr;
+    }
+
+    Task * findTask(Worker & w) {
+        if (auto t = w.deque.pop())
+            return *t;
+        if (auto t = w.injection->dequeue())
+            return t->release();
+        return steal(w);
+    }
+
+    static void runTask(Task * t) {
+        std::unique_ptr<Task> guard(t);
+        t->run();
+    }
+
+    void run(Worker & w) {
+        tWorker = &w;
+        w.injection.emplace(*m_injection);
+        for (;;) {
+            if (auto * t = findTask(w)) {
+                runTask(t);
+                continue;
+            }
+            // must be loaded before the last look, so that a wakeup after it is not lost.
+            auto wakeups = m_wakeups.load();
+            m_sleepers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto stopping = m_stopping.load();
+            auto * t = findTask(w);
+            if (t == nullptr && !stopping)
+                futexWait(&m_wakeups, wakeups, PARK_TIMEOUT);
+            m_sleepers.fetch_sub(1);
+            if (t != nullptr)
+                runTask(t);
+            else if (stopping)
+                break;
+        }
+        w.injection.reset();
+        tWorker = nullptr;
+    }
+
+    static inline thread_local Worker * tWorker = nullptr;
+
+    std::shared_ptr<InjectionQueue> m_injection;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    alignas(64) std::atomic<uint32_t> m_sleepers = 0;
+    // futex word, bumped when parked workers should look for tasks again.
+    std::atomic<uint32_t> m_wakeups = 0;
+    std::atomic<bool> m_stopping = false;
+};
+
+} // namespace camus
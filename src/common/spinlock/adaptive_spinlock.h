@@ -0,0 +1,82 @@
+#pragma once
+
+#include <common/spinlock/spin_count.h>
+#include <common/utils/Futex.h>
+#include <emmintrin.h>
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Spins for a while, then parks on a futex, so waiters don't burn a core while the holder is descheduled.
+//
+// Waiters spin up to twice the average hold time, measured by rdtsc between lock and unlock, within
+// [MIN_SPIN_CYCLES, MAX_SPIN_CYCLES]. Short critical sections are then handed off by spinning, while long
+// ones park right away. The futex part is the three state mutex of https://akkadia.org/drepper/futex.pdf
+
+namespace camus {
+class AdaptiveSpinLock {
+    static constexpr uint32_t UNLOCKED = 0;
+    static constexpr uint32_t LOCKED = 1;
+    // locked, and some waiters may be parked
+    static constexpr uint32_t CONTENDED = 2;
+
+    static constexpr uint64_t MIN_SPIN_CYCLES = 1000;
+    static constexpr uint64_t MAX_SPIN_CYCLES = 50000;
+    // only a bound, unlock always wakes a parked waiter.
+    static constexpr auto PARK_TIMEOUT = std::chrono::seconds(1);
+
+public:
+    AdaptiveSpinLock() = default;
+
+    AdaptiveSpinLock(const AdaptiveSpinLock &) = delete;
+    AdaptiveSpinLock & operator=(const AdaptiveSpinLock &) = delete;
+
+    void lock() {
+        if (!tryLock())
+            lockSlow();
+        m_acquiredAt = __rdtsc();
+    }
+
+    void unlock() {
+        // the average is only written by owners.
+        auto hold = static_cast<int64_t>(__rdtsc() - m_acquiredAt);
+        auto avg = static_cast<int64_t>(m_avgHoldCycles.load(std::memory_order_relaxed));
+        m_avgHoldCycles.store(static_cast<uint64_t>(avg + (hold - avg) / 8), std::memory_order_relaxed);
+        if (m_state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+            futexWake(&m_state, 1);
+    }
+
+private:
+    bool tryLock() {
+        uint32_t expected = UNLOCKED;
+        return m_state.load(std::memory_order_relaxed) == UNLOCKED &&
+               m_state.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void lockSlow() {
+        auto budget = std::clamp(m_avgHoldCycles.load(std::memory_order_relaxed) * 2, MIN_SPIN_CYCLES, MAX_SPIN_CYCLES);
+        auto start = __rdtsc();
+        while (__rdtsc() - start < budget) {
+            // once someone parked, spinning would only barge in front of it.
+            auto state = m_state.load(std::memory_order_relaxed);
+            if (state == CONTENDED)
+                break;
+            if (state == UNLOCKED && tryLock())
+                return;
+            _mm_pause();
+            CAMUS_COUNT_SPIN();
+        }
+        // may mark the lock contended when no one is parked, which only costs a spurious wake.
+        while (m_state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED)
+            futexWait(&m_state, CONTENDED, PARK_TIMEOUT);
+    }
+
+    alignas(64) std::atomic<uint32_t> m_state{UNLOCKED};
+    std::atomic<uint64_t> m_avgHoldCycles{0};
+    // only accessed by the owner
+    uint64_t m_acquiredAt = 0;
+};
+} // namespace camus
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <common/spinlock/spin_count.h>
+#include <emmintrin.h>
+
+#include <thread>
+
+namespace camus::detail::spinlock {
+// Retries tryFn with exponentially more pauses in between, then yields and starts over.
+template <typename F>
+void backoffUntil(F && tryFn) {
+    while (true) {
+        if (tryFn())
+            return;
+
+        for (int n = 1; n < 1024; n <<= 1) {
+            for (int i = 0; i < n; ++i) {
+                _mm_pause();
+            }
+            CAMUS_COUNT_SPIN();
+
+            if (tryFn())
+                return;
+        }
+
+        std::this_thread::yield();
+    }
+}
+} // namespace camus::detail::spinlock
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <common/spinlock/queue_lock_node_pool.h>
+#include <common/spinlock/spin_count.h>
+#include <emmintrin.h>
+
+#include <atomic>
+
+// CLH queue lock, see https://dada.cs.washington.edu/research/tr/1993/02/UW-CSE-93-02-02.pdf
+//
+// Each waiter spins on the node of its predecessor, and unlock only writes the own node, so a handoff costs
+// constant cache traffic however many threads wait. Waiters are served FIFO. Unlike MCS, unlock never waits,
+// but nodes move between threads: a thread takes over the node of its predecessor on unlock.
+
+namespace camus {
+class ClhSpinLock {
+    struct alignas(64) Node {
+        std::atomic<bool> locked{false};
+    };
+
+    using NodePool = detail::spinlock::QueueLockNodePool<Node>;
+
+public:
+    ClhSpinLock()
+        : m_tail(new Node()) {}
+
+    // Must be unlocked, the tail is then the node of the last owner.
+    ~ClhSpinLock() {
+        delete m_tail.load(std::memory_order_relaxed);
+    }
+
+    ClhSpinLock(const ClhSpinLock &) = delete;
+    ClhSpinLock & operator=(const ClhSpinLock &) = delete;
+
+    void lock() {
+        auto * node = NodePool::get();
+        node->locked.store(true, std::memory_order_relaxed);
+        auto * pred = m_tail.exchange(node, std::memory_order_acq_rel);
+        while (pred->locked.load(std::memory_order_acquire)) {
+            _mm_pause();
+            CAMUS_COUNT_SPIN();
+        }
+        m_owner = node;
+        m_pred = pred;
+    }
+
+    void unlock() {
+        // read before the handoff, the next owner overwrites them.
+        auto * node = m_owner;
+        auto * pred = m_pred;
+        node->locked.store(false, std::memory_order_release);
+        NodePool::put(pred);
+    }
+
+private:
+    alignas(64) std::atomic<Node *> m_tail;
+    // only accessed by the owner
+    Node * m_owner = nullptr;
+    Node * m_pred = nullptr;
+};
+} // namespace camus
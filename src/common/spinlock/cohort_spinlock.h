@@ -0,0 +1,101 @@
+#pragma once
+
+#include <common/spinlock/mcs_spinlock.h>
+#include <common/spinlock/ticket_spinlock.h>
+#include <common/utils/Numa.h>
+#include <sched.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// NUMA cohort lock, see https://dl.acm.org/doi/10.1145/2686884
+//
+// A thread takes the local lock of its node, then the global lock unless its node already owns it. On unlock
+// the global lock is passed along with the local one while threads of the same node wait, up to maxBatch
+// times in a row, so the protected data mostly moves within a node.
+//
+// GlobalLock is released by another thread than the one that locked it, so it must not track owners, as
+// TicketSpinLock, NginxSpinLock and TrivialSpinLock don't. McsSpinLock and ClhSpinLock are unsafe as
+// GlobalLock: they keep the queue node of the locking thread in m_owner for the unlocking thread. Any lock
+// works as LocalLock.
+//
+// NodeOf()() gives the node of the calling thread, the one of its current cpu by default. Nodes are taken
+// modulo nodeCount.
+
+namespace camus {
+namespace detail::spinlock {
+struct CpuNumaNode {
+    int operator()() const {
+        auto & cpuNodes = numaCpuNodes();
+        auto cpu = sched_getcpu();
+        return cpu >= 0 && static_cast<size_t>(cpu) < cpuNodes.size() ? cpuNodes[cpu] : 0;
+    }
+};
+} // namespace detail::spinlock
+
+template <
+    typename GlobalLock = TicketSpinLock,
+    typename LocalLock = McsSpinLock,
+    typename NodeOf = detail::spinlock::CpuNumaNode>
+class CohortSpinLock {
+    struct alignas(64) Node {
+        LocalLock local;
+        // threads of this node in or before local.lock()
+        std::atomic<int64_t> waiters{0};
+        // protected by local
+        bool ownsGlobal = false;
+        int64_t batch = 0;
+    };
+
+public:
+    explicit CohortSpinLock(int64_t maxBatch = 64, int nodeCount = numaNodeCount())
+        : m_maxBatch(maxBatch)
+        , m_nodeCount(static_cast<size_t>(nodeCount))
+        , m_nodes(std::make_unique<Node[]>(m_nodeCount)) {
+        assert(maxBatch > 0 && nodeCount > 0);
+    }
+
+    CohortSpinLock(const CohortSpinLock &) = delete;
+    CohortSpinLock & operator=(const CohortSpinLock &) = delete;
+
+    void lock() {
+        auto & node = localNode();
+        node.waiters.fetch_add(1, std::memory_order_relaxed);
+        node.local.lock();
+        node.waiters.fetch_sub(1, std::memory_order_relaxed);
+        if (!node.ownsGlobal) {
+            m_global.lock();
+            node.ownsGlobal = true;
+            node.batch = 0;
+        }
+        m_owner = &node;
+    }
+
+    void unlock() {
+        auto & node = *m_owner;
+        // waiters only decrease under the local lock, so a waiter seen here will take it.
+        if (node.waiters.load(std::memory_order_relaxed) > 0 && ++node.batch < m_maxBatch) {
+            node.local.unlock();
+            return;
+        }
+        node.ownsGlobal = false;
+        m_global.unlock();
+        node.local.unlock();
+    }
+
+private:
+    Node & localNode() { return m_nodes[static_cast<size_t>(m_nodeOf()) % m_nodeCount]; }
+
+    const int64_t m_maxBatch;
+    const size_t m_nodeCount;
+    std::unique_ptr<Node[]> m_nodes;
+    GlobalLock m_global;
+    [[no_unique_address]] NodeOf m_nodeOf;
+    // only accessed by the owner
+    Node * m_owner = nullptr;
+};
+} // namespace camus
@@ -0,0 +1,151 @@
+#include "common/spinlock/lock_profiling.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace camus {
+namespace {
+using detail::spinlock::LockProfileSlot;
+
+struct ThreadProfile {
+    // only the owner thread grows it, under mu, so the owner reads it without locking.
+    std::mutex mu;
+    std::vector<std::unique_ptr<LockProfileSlot>> slots;
+};
+
+struct Registry {
+    std::mutex mu;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, size_t> ids;
+    std::vector<ThreadProfile *> threads;
+    // merged from exited threads, indexed by id
+    std::vector<LockProfile> exited;
+};
+
+Registry & registry() {
+    static auto * r = new Registry();
+    return *r;
+}
+
+void mergeSlot(const LockProfileSlot & slot, LockProfile & profile) {
+    slot.waitNs.mergeInto(profile.waitNs);
+    slot.holdNs.mergeInto(profile.holdNs);
+    slot.spins.mergeInto(profile.spins);
+}
+
+// Registered on first use, merged into Registry::exited at thread exit.
+struct ThreadProfileHolder {
+    ThreadProfileHolder() {
+        auto & r = registry();
+        std::lock_guard lock(r.mu);
+        r.threads.push_back(&profile);
+    }
+
+    ~ThreadProfileHolder() {
+        auto & r = registry();
+        std::lock_guard lock(r.mu);
+        std::erase(r.threads, &profile);
+        r.exited.resize(std::max(r.exited.size(), profile.slots.size()));
+        for (size_t id = 0; id < profile.slots.size(); ++id) {
+            if (profile.slots[id])
+                mergeSlot(*profile.slots[id], r.exited[id]);
+        }
+    }
+
+    ThreadProfile profile;
+};
+
+void appendHistogram(std::ostringstream & os, std::string_view label, const LockHistogram & h) {
+    os << ' ' << label << " p50=" << h.percentile(0.5) << " p99=" << h.percentile(0.99) << " max=" << h.max;
+}
+} // namespace
+
+void LockHistogram::merge(const LockHistogram & other) {
+    for (size_t i = 0; i < BUCKETS; ++i)
+        buckets[i] += other.buckets[i];
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+uint64_t LockHistogram::percentile(double p) const {
+    if (count == 0)
+        return 0;
+    auto rank = static_cast<uint64_t>(static_cast<double>(count - 1) * p);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen > rank)
+            return i == 0 ? 0 : std::min(max, i == 64 ? UINT64_MAX : (uint64_t(1) << i) - 1);
+    }
+    return max;
+}
+
+std::vector<LockProfile> collectLockProfiles() {
+    auto & r = registry();
+    std::lock_guard lock(r.mu);
+    std::vector<LockProfile> res(r.names.size());
+    for (size_t id = 0; id < res.size(); ++id) {
+        res[id].name = r.names[id];
+        if (id < r.exited.size()) {
+            res[id].waitNs.merge(r.exited[id].waitNs);
+            res[id].holdNs.merge(r.exited[id].holdNs);
+            res[id].spins.merge(r.exited[id].spins);
+        }
+    }
+    for (auto * t : r.threads) {
+        std::lock_guard threadLock(t->mu);
+        for (size_t id = 0; id < t->slots.size(); ++id) {
+            if (t->slots[id])
+                mergeSlot(*t->slots[id], res[id]);
+        }
+    }
+    return res;
+}
+
+std::string dumpLockProfiles() {
+    std::ostringstream os;
+    for (auto & p : collectLockProfiles()) {
+        os << p.name << ": count=" << p.holdNs.count;
+        appendHistogram(os, "wait_ns", p.waitNs);
+        appendHistogram(os, "hold_ns", p.holdNs);
+        appendHistogram(os, "spins", p.spins);
+        os << '\n';
+    }
+    return os.str();
+}
+
+namespace detail::spinlock {
+void AtomicLockHistogram::mergeInto(LockHistogram & h) const {
+    for (size_t i = 0; i < LockHistogram::BUCKETS; ++i)
+        h.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+    h.count += count.load(std::memory_order_relaxed);
+    h.sum += sum.load(std::memory_order_relaxed);
+    h.max = std::max(h.max, max.load(std::memory_order_relaxed));
+}
+
+size_t lockProfileId(std::string_view name) {
+    auto & r = registry();
+    std::lock_guard lock(r.mu);
+    auto [it, inserted] = r.ids.try_emplace(std::string(name), r.names.size());
+    if (inserted)
+        r.names.emplace_back(name);
+    return it->second;
+}
+
+LockProfileSlot & lockProfileSlot(size_t id) {
+    thread_local ThreadProfileHolder holder;
+    auto & profile = holder.profile;
+    if (id >= profile.slots.size() || !profile.slots[id]) {
+        std::lock_guard lock(profile.mu);
+        if (id >= profile.slots.size())
+            profile.slots.resize(id + 1);
+        profile.slots[id] = std::make_unique<LockProfileSlot>();
+    }
+    return *profile.slots[id];
+}
+} // namespace detail::spinlock
+} // namespace camus
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Per-thread histograms of ProfiledLock, tagged by lock name. Locks of the same name share histograms.
+
+namespace camus {
+// Log2 buckets, bucket i holds values in [2^(i-1), 2^i), bucket 0 holds 0.
+struct LockHistogram {
+    static constexpr size_t BUCKETS = 65;
+
+    void merge(const LockHistogram & other);
+    // Upper bound of the bucket of the percentile.
+    uint64_t percentile(double p) const;
+
+    std::array<uint64_t, BUCKETS> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+};
+
+struct LockProfile {
+    std::string name;
+    LockHistogram waitNs;
+    LockHistogram holdNs;
+    LockHistogram spins;
+};
+
+// Merged over all threads, including exited ones. May be called any time, and does not block the locks.
+std::vector<LockProfile> collectLockProfiles();
+
+// One line per lock name.
+std::string dumpLockProfiles();
+
+namespace detail::spinlock {
+// Single writer, read by collectLockProfiles.
+struct AtomicLockHistogram {
+    void record(uint64_t v) {
+        auto i = v == 0 ? 0 : 64 - __builtin_clzll(v);
+        buckets[i].store(buckets[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        if (v > max.load(std::memory_order_relaxed))
+            max.store(v, std::memory_order_relaxed);
+    }
+
+    void mergeInto(LockHistogram & h) const;
+
+    std::array<std::atomic<uint64_t>, LockHistogram::BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+struct LockProfileSlot {
+    AtomicLockHistogram waitNs;
+    AtomicLockHistogram holdNs;
+    AtomicLockHistogram spins;
+};
+
+size_t lockProfileId(std::string_view name);
+
+// The slot of the calling thread.
+LockProfileSlot & lockProfileSlot(size_t id);
+} // namespace detail::spinlock
+} // namespace camus
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <common/spinlock/queue_lock_node_pool.h>
+#include <common/spinlock/spin_count.h>
+#include <emmintrin.h>
+
+#include <atomic>
+
+// MCS queue lock, see https://www.cs.rochester.edu/u/scott/papers/1991_TOCS_synch.pdf
+//
+// Each waiter spins on its own node, and unlock only writes the node of the next waiter, so a handoff costs
+// constant cache traffic however many threads wait. Waiters are served FIFO.
+
+namespace camus {
+class McsSpinLock {
+    struct alignas(64) Node {
+        std::atomic<Node *> next{nullptr};
+        std::atomic<bool> locked{false};
+    };
+
+    using NodePool = detail::spinlock::QueueLockNodePool<Node>;
+
+public:
+    McsSpinLock() = default;
+
+    McsSpinLock(const McsSpinLock &) = delete;
+    McsSpinLock & operator=(const McsSpinLock &) = delete;
+
+    void lock() {
+        auto * node = NodePool::get();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->locked.store(true, std::memory_order_relaxed);
+        auto * pred = m_tail.exchange(node, std::memory_order_acq_rel);
+        if (pred != nullptr) {
+            pred->next.store(node, std::memory_order_release);
+            while (node->locked.load(std::memory_order_acquire)) {
+                _mm_pause();
+                CAMUS_COUNT_SPIN();
+            }
+        }
+        m_owner = node;
+    }
+
+    void unlock() {
+        // read before the handoff, the next owner overwrites it.
+        auto * node = m_owner;
+        auto * next = node->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            auto * expected = node;
+            if (m_tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed)) {
+                NodePool::put(node);
+                return;
+            }
+            // a waiter swapped the tail but has not linked itself yet.
+            while ((next = node->next.load(std::memory_order_acquire)) == nullptr)
+                _mm_pause();
+        }
+        next->locked.store(false, std::memory_order_release);
+        NodePool::put(node);
+    }
+
+private:
+    alignas(64) std::atomic<Node *> m_tail{nullptr};
+    // only accessed by the owner
+    Node * m_owner = nullptr;
+};
+} // namespace camus
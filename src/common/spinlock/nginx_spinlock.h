@@ -1,10 +1,9 @@
 #pragma once
 
-#include <emmintrin.h>
+#include <common/spinlock/backoff.h>
 
 #include <atomic>
 #include <cstdint>
-#include <thread>
 
 namespace camus {
 class NginxSpinLock {
@@ -12,21 +11,7 @@ public:
     NginxSpinLock() = default;
 
     void lock() {
-        while (true) {
-            if (setToOne())
-                return;
-
-            for (int n = 1; n < 1024; n <<= 1) {
-                for (int i = 0; i < n; ++i) {
-                    _mm_pause();
-                }
-
-                if (setToOne())
-                    return;
-            }
-
-            std::this_thread::yield();
-        }
+        detail::spinlock::backoffUntil([this] { return setToOne(); });
     }
 
     void unlock() {
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <common/spinlock/lock_profiling.h>
+#include <common/spinlock/spin_count.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+// Wraps any of the spinlocks, recording acquire wait time, hold time and spin iterations per thread under a
+// lock name, see lock_profiling.h for dumping them. Without CAMUS_LOCK_PROFILING (cmake -DENABLE_LOCK_PROFILING=ON)
+// it is the wrapped lock itself, and the name is dropped.
+//
+//     ProfiledLock<TicketSpinLock> m_lock{"session_table"};
+
+namespace camus {
+#ifdef CAMUS_LOCK_PROFILING
+template <typename Lock>
+class ProfiledLock {
+public:
+    explicit ProfiledLock(std::string_view name)
+        : m_id(detail::spinlock::lockProfileId(name)) {}
+
+    void lock() {
+        auto spins = detail::spinlock::tSpinCount;
+        auto start = now();
+        m_lock.lock();
+        m_acquiredAt = now();
+        auto & slot = detail::spinlock::lockProfileSlot(m_id);
+        slot.waitNs.record(m_acquiredAt - start);
+        slot.spins.record(detail::spinlock::tSpinCount - spins);
+    }
+
+    void unlock() {
+        // read before unlocking, the next owner overwrites it.
+        auto hold = now() - m_acquiredAt;
+        m_lock.unlock();
+        detail::spinlock::lockProfileSlot(m_id).holdNs.record(hold);
+    }
+
+    // Shared holders are not timed, only their wait.
+    void lock_shared()
+    requires requires(Lock & l) { l.lock_shared(); }
+    {
+        auto spins = detail::spinlock::tSpinCount;
+        auto start = now();
+        m_lock.lock_shared();
+        auto & slot = detail::spinlock::lockProfileSlot(m_id);
+        slot.waitNs.record(now() - start);
+        slot.spins.record(detail::spinlock::tSpinCount - spins);
+    }
+
+    void unlock_shared()
+    requires requires(Lock & l) { l.unlock_shared(); }
+    {
+        m_lock.unlock_shared();
+    }
+
+private:
+    static uint64_t now() {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+
+    Lock m_lock;
+    size_t m_id;
+    // only accessed by the owner
+    uint64_t m_acquiredAt = 0;
+};
+#else
+template <typename Lock>
+class ProfiledLock : public Lock {
+public:
+    explicit ProfiledLock(std::string_view) {}
+};
+#endif
+} // namespace camus
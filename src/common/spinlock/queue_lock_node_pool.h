@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+namespace camus::detail::spinlock {
+// Thread local free list of queue lock nodes, so that lock() doesn't take a node argument and a thread may hold
+// several queue locks at once. Nodes left in the list are freed at thread exit.
+template <typename Node>
+class QueueLockNodePool {
+public:
+    static Node * get() {
+        auto & nodes = freeList().nodes;
+        if (nodes.empty())
+            return new Node();
+        auto * node = nodes.back();
+        nodes.pop_back();
+        return node;
+    }
+
+    static void put(Node * node) {
+        freeList().nodes.push_back(node);
+    }
+
+private:
+    struct FreeList {
+        ~FreeList() {
+            for (auto * node : nodes)
+                delete node;
+        }
+
+        std::vector<Node *> nodes;
+    };
+
+    static FreeList & freeList() {
+        thread_local FreeList list;
+        return list;
+    }
+};
+} // namespace camus::detail::spinlock
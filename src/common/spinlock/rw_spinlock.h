@@ -0,0 +1,130 @@
+#pragma once
+
+#include <common/spinlock/backoff.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Reader-writer spinlock with writer preference: once a writer waits, new readers back off until it is done.
+// Waits back off like NginxSpinLock.
+//
+// With PerCoreReaders, readers count themselves in one cache line per cpu instead of one shared word, so
+// shared acquisition doesn't bounce a line between cores, while a writer has to sum all lines (big-reader
+// lock). A reader may unlock on another cpu than it locked on, only the sum of the lines matters.
+
+namespace camus {
+namespace detail::spinlock {
+struct alignas(64) ReaderCount {
+    std::atomic<int64_t> count{0};
+};
+} // namespace detail::spinlock
+
+template <bool PerCoreReaders = false>
+class BasicRwSpinLock;
+
+template <>
+class BasicRwSpinLock<false> {
+    static constexpr int64_t WRITER = 1;
+    static constexpr int64_t WRITER_WAITING = 2;
+    static constexpr int64_t READER = 4;
+
+public:
+    BasicRwSpinLock() = default;
+
+    void lock() {
+        detail::spinlock::backoffUntil([this] {
+            auto v = m_lock.load(std::memory_order_relaxed);
+            if ((v & ~WRITER_WAITING) == 0)
+                // clears WRITER_WAITING, other waiting writers set it again on their next try.
+                return m_lock.compare_exchange_weak(v, WRITER, std::memory_order_acquire, std::memory_order_relaxed);
+            if ((v & WRITER_WAITING) == 0)
+                m_lock.fetch_or(WRITER_WAITING, std::memory_order_relaxed);
+            return false;
+        });
+    }
+
+    void unlock() {
+        m_lock.fetch_and(~WRITER, std::memory_order_release);
+    }
+
+    void lock_shared() {
+        detail::spinlock::backoffUntil([this] {
+            auto v = m_lock.load(std::memory_order_relaxed);
+            return (v & (WRITER | WRITER_WAITING)) == 0 &&
+                   m_lock.compare_exchange_weak(v, v + READER, std::memory_order_acquire, std::memory_order_relaxed);
+        });
+    }
+
+    void unlock_shared() {
+        m_lock.fetch_sub(READER, std::memory_order_release);
+    }
+
+private:
+    // readers * READER | WRITER_WAITING | WRITER
+    alignas(64) std::atomic<int64_t> m_lock{0};
+};
+
+template <>
+class BasicRwSpinLock<true> {
+public:
+    BasicRwSpinLock()
+        : m_readerCount(static_cast<size_t>(std::max(get_nprocs_conf(), 1)))
+        , m_readers(std::make_unique<detail::spinlock::ReaderCount[]>(m_readerCount)) {}
+
+    // The writer flag is set seq_cst before summing the readers, while a reader counts itself seq_cst before
+    // loading the flag. So either the writer sees the reader, or the reader sees the writer.
+    void lock() {
+        detail::spinlock::backoffUntil([this] {
+            bool expected = false;
+            return !m_writer.load(std::memory_order_relaxed) && m_writer.compare_exchange_weak(expected, true);
+        });
+        // new readers back off from now on, wait for the present ones.
+        detail::spinlock::backoffUntil([this] {
+            int64_t sum = 0;
+            for (size_t i = 0; i < m_readerCount; ++i)
+                sum += m_readers[i].count.load();
+            return sum == 0;
+        });
+    }
+
+    void unlock() {
+        m_writer.store(false, std::memory_order_release);
+    }
+
+    void lock_shared() {
+        detail::spinlock::backoffUntil([this] {
+            if (m_writer.load(std::memory_order_relaxed))
+                return false;
+            auto & readers = local();
+            readers.count.fetch_add(1);
+            if (!m_writer.load())
+                return true;
+            readers.count.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        });
+    }
+
+    void unlock_shared() {
+        local().count.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    detail::spinlock::ReaderCount & local() {
+        auto cpu = sched_getcpu();
+        return m_readers[static_cast<size_t>(std::max(cpu, 0)) % m_readerCount];
+    }
+
+    alignas(64) std::atomic<bool> m_writer{false};
+    size_t m_readerCount;
+    std::unique_ptr<detail::spinlock::ReaderCount[]> m_readers;
+};
+
+using RwSpinLock = BasicRwSpinLock<false>;
+// big-reader lock
+using BrSpinLock = BasicRwSpinLock<true>;
+} // namespace camus
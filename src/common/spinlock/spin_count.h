@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Spin iterations of the calling thread, read by ProfiledLock. Compiled out unless CAMUS_LOCK_PROFILING.
+
+#ifdef CAMUS_LOCK_PROFILING
+namespace camus::detail::spinlock {
+inline thread_local uint64_t tSpinCount = 0;
+} // namespace camus::detail::spinlock
+
+#define CAMUS_COUNT_SPIN() (++::camus::detail::spinlock::tSpinCount)
+#else
+#define CAMUS_COUNT_SPIN() ((void)0)
+#endif
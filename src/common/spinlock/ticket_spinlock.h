@@ -1,5 +1,6 @@
 #pragma once
 
+#include <common/spinlock/spin_count.h>
 #include <emmintrin.h>
 
 #include <atomic>
@@ -14,9 +15,10 @@ public:
     void lock() {
         auto ticket = m_ticket.fetch_add(1, std::memory_order_acquire);
         while (true) {
-            if (m_lock.load(std::memory_order_relaxed) == ticket) {
+            if (m_lock.load(std::memory_order_acquire) == ticket) {
                 return;
             }
+            CAMUS_COUNT_SPIN();
         }
     }
 
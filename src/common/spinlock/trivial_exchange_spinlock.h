@@ -1,5 +1,7 @@
 #pragma once
 
+#include <common/spinlock/spin_count.h>
+
 #include <atomic>
 #include <cstdint>
 #include <thread>
@@ -14,6 +16,7 @@ public:
             int64_t expected = 0;
             if (m_lock.compare_exchange_strong(expected, 1, std::memory_order_acquire))
                 return;
+            CAMUS_COUNT_SPIN();
         }
     }
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+
+// Fences for a hot path paired with a rare one, like folly::asymmetric_thread_fence_light/heavy. A light fence
+// on one thread and a heavy fence on another order memory as two seq_cst fences would, while the light one is
+// only a compiler barrier: the heavy one makes every running thread of the process execute a memory barrier by
+// membarrier(2). Without membarrier, or under TSAN which doesn't model it, both are seq_cst fences.
+
+namespace camus {
+
+namespace detail::fence {
+// set once membarrier is registered, only then light fences may be compiler barriers.
+inline std::atomic<bool> gMembarrierReady = false;
+} // namespace detail::fence
+
+// Registers the process for membarrier, returns false if it is not supported. Called by the first heavy fence,
+// call it early so that light fences are cheap from the start.
+inline bool asymmetricThreadFenceInit() {
+    static const bool ready = [] {
+#if defined(__SANITIZE_THREAD__)
+        return false;
+#else
+        if (syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) != 0)
+            return false;
+        detail::fence::gMembarrierReady.store(true);
+        return true;
+#endif
+    }();
+    return ready;
+}
+
+inline void asymmetricThreadFenceLight() {
+    if (detail::fence::gMembarrierReady.load(std::memory_order_relaxed))
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// A syscall, keep it off hot paths.
+inline void asymmetricThreadFenceHeavy() {
+    if (asymmetricThreadFenceInit())
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+    else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+} // namespace camus
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+// Thin wrappers of the futex syscall. std::atomic::wait has no timeout.
+
+namespace camus {
+
+// Sleeps if *addr == expected until woken or timeout. Returns false on timeout.
+inline bool futexWait(std::atomic<uint32_t> * addr, uint32_t expected, std::chrono::nanoseconds timeout) {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "");
+    timespec ts{
+        .tv_sec = static_cast<time_t>(timeout.count() / 1000000000),
+        .tv_nsec = static_cast<long>(timeout.count() % 1000000000),
+    };
+    auto r = syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+    return r == 0 || errno != ETIMEDOUT;
+}
+
+inline void futexWake(std::atomic<uint32_t> * addr, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+inline void futexWakeAll(std::atomic<uint32_t> * addr) {
+    futexWake(addr, INT_MAX);
+}
+
+} // namespace camus
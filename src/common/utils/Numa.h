@@ -0,0 +1,95 @@
+#pragma once
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// NUMA topology from sysfs, so that libnuma is not required.
+
+namespace camus {
+
+// Ids of the NUMA nodes in ascending order, {0} if unknown. They need not be contiguous, e.g. with nodes
+// offline or without memory.
+inline std::vector<int> numaNodeIds() {
+    std::vector<int> ids;
+    std::error_code ec;
+    for (auto & entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        auto name = entry.path().filename().string();
+        if (name.size() > 4 && name.starts_with("node") && name.find_first_not_of("0123456789", 4) == std::string::npos)
+            ids.push_back(std::stoi(name.substr(4)));
+    }
+    if (ids.empty())
+        ids.push_back(0);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// Size of tables indexed by node id: the largest id + 1, so that it may count ids of absent nodes.
+inline int numaNodeCount() { return numaNodeIds().back() + 1; }
+
+// Node of the cpu the calling thread is running on.
+inline int currentNumaNode() {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return 0;
+    return static_cast<int>(node);
+}
+
+// Cpus of a node, parsed from a cpulist like "0-3,8-11".
+inline std::vector<int> numaNodeCpus(int node) {
+    std::vector<int> cpus;
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    std::getline(in, list);
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty())
+            continue;
+        auto dash = range.find('-');
+        auto first = std::stoi(range.substr(0, dash));
+        auto last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (auto cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Node of each cpu, indexed by cpu id. Cpus not found in sysfs are on node 0.
+inline const std::vector<int> & numaCpuNodes() {
+    static const auto nodes = [] {
+        std::vector<int> res;
+        for (auto node : numaNodeIds()) {
+            for (auto cpu : numaNodeCpus(node)) {
+                if (static_cast<size_t>(cpu) >= res.size())
+                    res.resize(cpu + 1, 0);
+                res[cpu] = node;
+            }
+        }
+        return res;
+    }();
+    return nodes;
+}
+
+// Pins the calling thread to the cpus of a node. Returns false if the node is unknown or pinning fails.
+inline bool pinToNumaNode(int node) {
+    auto cpus = numaNodeCpus(node);
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+} // namespace camus
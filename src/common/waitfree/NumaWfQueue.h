@@ -0,0 +1,121 @@
+#pragma once
+
+#include <common/utils/Numa.h>
+#include <common/waitfree/WfQueue.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace camus {
+
+// A front-end of one `WfQueue` per NUMA node, so that m_tail and m_head of a shard are only bounced among
+// cpus of one node. A handle enqueues to the shard of its node, and dequeues from it first, then steals from
+// other shards in a fixed order starting from the next node. Other shards are only read, by `WfQueue::empty`,
+// unless they have values: a dequeue from an empty shard would take a cell and write its m_head.
+//
+// Ordering: values enqueued by one handle go to one shard, so they are dequeued in the order they were
+// enqueued, as in `WfQueue`. Values of handles on different nodes are not ordered against each other, and
+// a dequeue may return empty while a shard it already checked gets a value.
+//
+// The node of a handle is taken when it is created, pin the thread to a node before that, e.g. by
+// `pinToNumaNode`.
+//
+// Memory follows the first-touch policy: each shard is built by a thread pinned to its node, and later
+// segments mostly come from spares recycled within the shard. Segments a shard allocates while a handle
+// of another node steals from it are placed on that node.
+template <typename T, typename Policy = WfQueuePolicy<>>
+class NumaWfQueue {
+    using Shard = WfQueue<T, Policy>;
+
+public:
+    class Handle {
+    public:
+        explicit Handle(NumaWfQueue & q, int node = currentNumaNode())
+            : m_queue(q)
+            , m_node(static_cast<size_t>(node) % q.m_shards.size()) {
+            m_handles.reserve(q.m_shards.size());
+            for (auto & shard : q.m_shards)
+                m_handles.push_back(std::make_unique<typename Shard::Handle>(*shard));
+        }
+
+        Handle(const Handle &) = delete;
+        Handle & operator=(const Handle &) = delete;
+
+        void enqueue(T v) { local().enqueue(std::move(v)); }
+
+        void enqueueBulk(std::span<T> values) { local().enqueueBulk(values); }
+
+        // Returns std::nullopt if all shards are empty.
+        std::optional<T> dequeue() {
+            if (auto v = local().dequeue())
+                return v;
+            for (size_t i = 1; i < m_handles.size(); ++i) {
+                auto node = (m_node + i) % m_handles.size();
+                if (m_queue.m_shards[node]->empty())
+                    continue;
+                if (auto v = m_handles[node]->dequeue())
+                    return v;
+            }
+            return std::nullopt;
+        }
+
+        size_t node() const { return m_node; }
+
+        // Counters of this handle over all shards.
+        WfQueueStats stats() const {
+            WfQueueStats res;
+            for (auto & h : m_handles)
+                res += h->stats();
+            return res;
+        }
+
+    private:
+        typename Shard::Handle & local() { return *m_handles[m_node]; }
+
+        NumaWfQueue & m_queue;
+        size_t m_node;
+        // one per shard, indexed by node
+        std::vector<std::unique_ptr<typename Shard::Handle>> m_handles;
+    };
+
+    explicit NumaWfQueue(int nodeCount = numaNodeCount())
+        : m_shards(static_cast<size_t>(nodeCount)) {
+        assert(nodeCount > 0);
+        if (nodeCount == 1) {
+            m_shards[0] = std::make_unique<Shard>();
+            return;
+        }
+        for (int i = 0; i < nodeCount; ++i) {
+            std::thread([this, i] {
+                // a node without cpus can't be pinned to, its shard is placed anywhere.
+                pinToNumaNode(i);
+                m_shards[i] = std::make_unique<Shard>();
+            }).join();
+        }
+    }
+
+    NumaWfQueue(const NumaWfQueue &) = delete;
+    NumaWfQueue & operator=(const NumaWfQueue &) = delete;
+
+    size_t nodeCount() const { return m_shards.size(); }
+
+    WfQueueStats stats() const {
+        WfQueueStats res;
+        for (auto & shard : m_shards)
+            res += shard->stats();
+        return res;
+    }
+
+private:
+    // separately allocated, so that shards share no cache lines.
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
+
+} // namespace camus
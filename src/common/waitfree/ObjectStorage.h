@@ -0,0 +1,341 @@
+#pragma once
+
+#include <common/utils/Futex.h>
+#include <emmintrin.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Read-mostly storage with split reference counts. Readers take the current object by one fetch_add on the
+// outer counter of the store, which also holds the slot index of the current object. A writer puts the new
+// object into a free slot, swaps the index and moves the outer count of the old object into its inner
+// counter, and whoever brings the inner counter to 0 destroys it and frees its slot.
+//
+// Writers don't lock. A blind publish swaps the index by one exchange, a conditional one by CAS, which only
+// fails when the store changed. A writer only waits when all slots are held by old objects still being read,
+// and then sleeps on a futex instead of spinning.
+//
+// With PerCpuReads, the outer counter is split into one cache line per cpu, each also holding the index, so
+// readers on different cpus don't contend. A writer then swaps the index of the store, then that of every cpu,
+// and adds up the outer counts, and writers are serialized for that sweep. A reader whose cpu is not swept yet
+// sees the index of the store differ from its own, and takes the new object by the counter of the store
+// instead, so publishing stays atomic: no reader gets the old object once another got the new one.
+//
+// The last reader of an old object destroys it inline, unless the store has a Reclaimer, which takes it by one
+// CAS and destroys it later on its own thread.
+//
+// See Snapshot.h for a typed interface.
+
+namespace camus {
+namespace detail::object_storage {
+
+constexpr uintptr_t PERSISTENT = 1;
+constexpr uintptr_t TEMPORAL = 2;
+
+// how long a writer sleeps for a free slot before looking again.
+constexpr auto SLOT_WAIT_TIMEOUT = std::chrono::milliseconds(100);
+constexpr int SPIN_COUNT = 64;
+
+struct alignas(64) ReadShard {
+    std::atomic<uintptr_t> state = 0; // outer counter + index to objects
+};
+
+inline size_t cpuCount() {
+    static const size_t count = std::max(get_nprocs_conf(), 1);
+    return count;
+}
+
+// sched_getcpu is a vdso call, which reads the cpu from rseq on recent glibc.
+inline size_t currentCpu() {
+    auto cpu = sched_getcpu();
+    return cpu < 0 ? 0 : static_cast<size_t>(cpu);
+}
+
+} // namespace detail::object_storage
+
+class Reclaimer;
+
+// The part of a store that objects refer to, to wake writers when freeing a slot.
+struct StoreBase {
+    std::atomic<uint32_t> sleepers = 0; // writers waiting for a slot
+    std::atomic<uint32_t> wakeups = 0;  // futex word
+    Reclaimer * reclaimer = nullptr;    // destroys objects inline if null
+};
+
+struct Object {
+    std::atomic<uintptr_t> rc; // inner counter
+    std::atomic<Object *> * back_ptr;
+    StoreBase * store;
+    void (*dtor)(void * obj);
+    Object * next_retired; // linked by Reclaimer
+};
+
+// Destroys retired objects off the reader path. Retiring is a CAS push to an intrusive list, so it doesn't
+// allocate. Must outlive the stores using it.
+//
+//     Reclaimer reclaimer(std::chrono::milliseconds(10)); // reclaims on a background thread
+//     Reclaimer reclaimer;                                // reclaims only by reclaim()
+class Reclaimer {
+public:
+    Reclaimer() = default;
+
+    explicit Reclaimer(std::chrono::milliseconds period)
+        : m_thread([this, period] {
+            while (m_stopping.load() == 0) {
+                reclaim();
+                futexWait(&m_stopping, 0, period);
+            }
+        }) {}
+
+    ~Reclaimer() {
+        if (m_thread.joinable()) {
+            m_stopping.store(1);
+            futexWakeAll(&m_stopping);
+            m_thread.join();
+        }
+        reclaim();
+    }
+
+    Reclaimer(const Reclaimer &) = delete;
+    Reclaimer & operator=(const Reclaimer &) = delete;
+
+    void retire(Object * obj) {
+        auto * head = m_retired.load(std::memory_order_relaxed);
+        do {
+            obj->next_retired = head;
+        } while (!m_retired.compare_exchange_weak(head, obj, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Destroys objects retired so far, returns how many.
+    size_t reclaim() {
+        auto * obj = m_retired.exchange(nullptr, std::memory_order_acquire);
+        size_t count = 0;
+        while (obj != nullptr) {
+            auto * next = obj->next_retired;
+            obj->dtor(obj);
+            obj = next;
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::atomic<Object *> m_retired = nullptr;
+    std::atomic<uint32_t> m_stopping = 0; // futex word
+    std::thread m_thread;
+};
+
+// SlotCount bounds the versions alive at once, including the current one, so a writer only waits when
+// SlotCount - 1 old versions are still being read.
+template <size_t SlotCount = 4, bool PerCpuReads = false>
+struct Store : StoreBase {
+    static_assert(SlotCount >= 2 && (SlotCount & (SlotCount - 1)) == 0, "SlotCount must be a power of 2");
+
+    static constexpr uintptr_t OBJECT_MASK = SlotCount - 1;
+    static constexpr uintptr_t COUNT_MASK = ~OBJECT_MASK;
+    static constexpr uintptr_t COUNT_INC = SlotCount;
+
+    std::atomic<uintptr_t> state; // outer counter + index to objects, PerCpuReads only counts readers here mid-sweep
+    std::array<std::atomic<Object *>, SlotCount> objects;
+    // PerCpuReads only
+    std::unique_ptr<detail::object_storage::ReadShard[]> shards;
+    size_t shardCount = 0;
+    std::atomic<bool> sweeping = false; // taken by the writer swapping shards
+};
+
+enum class PublishResult {
+    SUCCESS,
+    // all slots are taken.
+    NO_SLOT,
+    // the current object is not the expected one.
+    CONFLICT,
+};
+
+namespace detail::object_storage {
+
+inline void storeWakeWriters(StoreBase * store) {
+    if (store->sleepers.load() == 0)
+        return;
+    store->wakeups.fetch_add(1);
+    futexWakeAll(&store->wakeups);
+}
+
+// The slot is seq_cst freed before loading sleepers, while a writer increases sleepers before its last look
+// for a slot. So either the writer sees the slot, or we see the writer.
+inline void storeFreeSlot(StoreBase * store, std::atomic<Object *> * slot) {
+    slot->store(nullptr);
+    storeWakeWriters(store);
+}
+
+inline void storeReleaseObject(Object * obj) {
+    auto * store = obj->store;
+    storeFreeSlot(store, obj->back_ptr);
+    if (store->reclaimer != nullptr)
+        store->reclaimer->retire(obj);
+    else
+        obj->dtor(obj);
+}
+
+template <size_t SlotCount, bool PerCpuReads>
+void storeInitObject(Store<SlotCount, PerCpuReads> * store, Object * obj, size_t idx, void (*dtor)(void *)) {
+    obj->rc.store(PERSISTENT);
+    obj->back_ptr = &store->objects[idx];
+    obj->store = store;
+    obj->dtor = dtor;
+}
+
+// Moves the outer count of the object swapped out into its inner counter.
+template <size_t SlotCount, bool PerCpuReads>
+void storeRetire(Store<SlotCount, PerCpuReads> * store, uintptr_t old_idx, uintptr_t old_cnt) {
+    auto * old_obj = store->objects[old_idx].load();
+    auto cnt_dif = static_cast<uintptr_t>(-static_cast<intptr_t>(old_cnt * TEMPORAL + PERSISTENT));
+    auto cnt_res = old_obj->rc.fetch_add(cnt_dif) + cnt_dif;
+    if (cnt_res == 0) {
+        storeReleaseObject(old_obj);
+    }
+}
+
+} // namespace detail::object_storage
+
+template <size_t SlotCount, bool PerCpuReads>
+void storeCreate(Store<SlotCount, PerCpuReads> * store, Object * obj, void (*dtor)(void *), Reclaimer * reclaimer = nullptr) {
+    store->reclaimer = reclaimer;
+    store->state.store(0);
+    if constexpr (PerCpuReads) {
+        store->shardCount = detail::object_storage::cpuCount();
+        store->shards = std::make_unique<detail::object_storage::ReadShard[]>(store->shardCount);
+    }
+    store->objects[0].store(obj);
+    for (size_t i = 1; i != SlotCount; ++i)
+        store->objects[i].store(nullptr);
+    detail::object_storage::storeInitObject(store, obj, 0, dtor);
+}
+
+// No reader may hold an object.
+template <size_t SlotCount, bool PerCpuReads>
+void storeDestroy(Store<SlotCount, PerCpuReads> * store) {
+    using namespace detail::object_storage;
+    auto state = store->state.load();
+    auto count = state / SlotCount;
+    if constexpr (PerCpuReads) {
+        for (size_t i = 0; i != store->shardCount; ++i)
+            count += store->shards[i].state.load() / SlotCount;
+    }
+    auto * obj = store->objects[state & Store<SlotCount, PerCpuReads>::OBJECT_MASK].load();
+    obj->rc.fetch_sub(count * TEMPORAL + PERSISTENT);
+    storeReleaseObject(obj);
+}
+
+inline void storeReadRelease(Object * obj) {
+    using namespace detail::object_storage;
+    auto prev = obj->rc.fetch_add(TEMPORAL) + TEMPORAL;
+    if (prev == 0) {
+        storeReleaseObject(obj);
+    }
+}
+
+template <size_t SlotCount, bool PerCpuReads>
+Object * storeReadRequire(Store<SlotCount, PerCpuReads> * store) {
+    using S = Store<SlotCount, PerCpuReads>;
+    if constexpr (PerCpuReads) {
+        auto & shard = store->shards[detail::object_storage::currentCpu() % store->shardCount].state;
+        auto idx = shard.fetch_add(S::COUNT_INC) & S::OBJECT_MASK;
+        // the object held can't be freed, so its slot can't be reused: a matching index means it is current.
+        auto * obj = store->objects[idx].load();
+        if ((store->state.load() & S::OBJECT_MASK) == idx)
+            return obj;
+        // a sweep is on and hasn't reached this cpu.
+        storeReadRelease(obj);
+    }
+    auto prev = store->state.fetch_add(S::COUNT_INC);
+    return store->objects[prev & S::OBJECT_MASK].load();
+}
+
+// Publishes obj without waiting for readers. If expected is not null, only publishes while it is the current
+// object, the caller must hold it by storeReadRequire. On failure obj is left to the caller. With PerCpuReads
+// it may wait for the sweep of another writer.
+template <size_t SlotCount, bool PerCpuReads>
+PublishResult storeTryPublish(Store<SlotCount, PerCpuReads> * store, Object * obj, void (*dtor)(void *),
+                              Object * expected = nullptr) {
+    using namespace detail::object_storage;
+    // the expected object can't be freed while held, so its slot identifies it.
+    auto isCurrent = [&](uintptr_t state) {
+        return &store->objects[state & Store<SlotCount, PerCpuReads>::OBJECT_MASK] == expected->back_ptr;
+    };
+    if (expected != nullptr && !isCurrent(store->state.load()))
+        return PublishResult::CONFLICT;
+    size_t idx = 0;
+    for (;; ++idx) {
+        if (idx == SlotCount)
+            return PublishResult::NO_SLOT;
+        Object * empty = nullptr;
+        if (store->objects[idx].load() == nullptr && store->objects[idx].compare_exchange_strong(empty, obj))
+            break;
+    }
+    storeInitObject(store, obj, idx, dtor);
+    uintptr_t prev = 0;
+    if constexpr (PerCpuReads) {
+        for (auto i = 0; store->sweeping.exchange(true); ++i) {
+            if (i < SPIN_COUNT)
+                _mm_pause();
+            else
+                std::this_thread::yield();
+        }
+        // the index only changes under sweeping, the exchange also takes the readers falling back to the store.
+        if (expected != nullptr && !isCurrent(store->state.load())) {
+            store->sweeping.store(false);
+            storeFreeSlot(store, &store->objects[idx]);
+            return PublishResult::CONFLICT;
+        }
+        prev = store->state.exchange(idx);
+        for (size_t i = 0; i != store->shardCount; ++i)
+            prev += store->shards[i].state.exchange(idx) & Store<SlotCount, PerCpuReads>::COUNT_MASK;
+        store->sweeping.store(false);
+    } else if (expected == nullptr) {
+        prev = store->state.exchange(idx);
+    } else {
+        prev = store->state.load();
+        do {
+            if (!isCurrent(prev)) {
+                storeFreeSlot(store, &store->objects[idx]);
+                return PublishResult::CONFLICT;
+            }
+            // only fails on a new reader or writer, so some thread made progress.
+        } while (!store->state.compare_exchange_weak(prev, idx));
+    }
+    storeRetire(store, prev & Store<SlotCount, PerCpuReads>::OBJECT_MASK, prev / SlotCount);
+    // conditional writers waiting for a slot would conflict now.
+    storeWakeWriters(store);
+    return PublishResult::SUCCESS;
+}
+
+// Like storeTryPublish, but sleeps while all slots are taken, so it never returns NO_SLOT.
+template <size_t SlotCount, bool PerCpuReads>
+PublishResult storePublish(Store<SlotCount, PerCpuReads> * store, Object * obj, void (*dtor)(void *),
+                           Object * expected = nullptr) {
+    using namespace detail::object_storage;
+    for (;;) {
+        auto r = storeTryPublish(store, obj, dtor, expected);
+        if (r != PublishResult::NO_SLOT)
+            return r;
+        // loaded before the last try, so that a wakeup after it is not lost.
+        auto wakeups = store->wakeups.load();
+        store->sleepers.fetch_add(1);
+        r = storeTryPublish(store, obj, dtor, expected);
+        if (r == PublishResult::NO_SLOT)
+            futexWait(&store->wakeups, wakeups, SLOT_WAIT_TIMEOUT);
+        store->sleepers.fetch_sub(1);
+        if (r != PublishResult::NO_SLOT)
+            return r;
+    }
+}
+
+} // namespace camus
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <common/waitfree/ObjectStorage.h>
+
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace camus {
+
+// A value of T published to many readers, on top of ObjectStorage. Reading is one fetch_add on the store and
+// one on the version read, and never blocks. Writers don't lock, and the old version is destroyed by its last
+// reader. SlotCount bounds the versions alive at once, and PerCpuReads spreads the reader count over cpus,
+// see Store.
+//
+//     Snapshot<RoutingTable> table(load());
+//     if (auto r = table.read(); r->contains(key)) ...
+//     table.update([&](const RoutingTable & t) { return t.with(key, route); });
+//
+// Guards must not outlive the Snapshot.
+template <typename T, size_t SlotCount = 4, bool PerCpuReads = false>
+class Snapshot {
+    struct Node : Object {
+        explicit Node(T && v)
+            : value(std::move(v)) {}
+
+        T value;
+    };
+
+    static void destroy(void * obj) { delete static_cast<Node *>(static_cast<Object *>(obj)); }
+
+public:
+    // Holds a version until destruction.
+    class ReadGuard {
+    public:
+        ReadGuard(ReadGuard && other) noexcept
+            : m_node(std::exchange(other.m_node, nullptr)) {}
+
+        ReadGuard & operator=(ReadGuard && other) noexcept {
+            if (this != &other) {
+                release();
+                m_node = std::exchange(other.m_node, nullptr);
+            }
+            return *this;
+        }
+
+        ~ReadGuard() { release(); }
+
+        const T & operator*() const { return m_node->value; }
+        const T * operator->() const { return &m_node->value; }
+        const T & get() const { return m_node->value; }
+
+    private:
+        friend class Snapshot;
+
+        explicit ReadGuard(Node * node)
+            : m_node(node) {}
+
+        void release() {
+            if (m_node != nullptr)
+                storeReadRelease(m_node);
+        }
+
+        Node * m_node;
+    };
+
+    // Old versions are destroyed by the reclaimer if given, instead of by their last reader.
+    explicit Snapshot(T v = T(), Reclaimer * reclaimer = nullptr) {
+        storeCreate(&m_store, new Node(std::move(v)), &destroy, reclaimer);
+    }
+
+    ~Snapshot() { storeDestroy(&m_store); }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot & operator=(const Snapshot &) = delete;
+
+    ReadGuard read() const { return ReadGuard(static_cast<Node *>(storeReadRequire(&m_store))); }
+
+    // Builds the next version by fn(const T & current) -> T. If another writer publishes first, fn is called
+    // again on its version, so fn should be cheap and free of side effects. Nothing is published if fn throws.
+    template <typename F>
+    requires std::convertible_to<std::invoke_result_t<F &, const T &>, T>
+    void update(F && fn) {
+        for (;;) {
+            auto current = read();
+            std::unique_ptr<Node> next(new Node(fn(*current)));
+            if (storePublish(&m_store, next.get(), &destroy, current.m_node) == PublishResult::SUCCESS) {
+                next.release();
+                return;
+            }
+        }
+    }
+
+    void publish(T v) {
+        std::unique_ptr<Node> next(new Node(std::move(v)));
+        storePublish(&m_store, next.get(), &destroy);
+        next.release();
+    }
+
+    // Returns false without blocking if all slots are held by old versions still being read, v is dropped then.
+    bool tryPublish(T v) {
+        std::unique_ptr<Node> next(new Node(std::move(v)));
+        if (storeTryPublish(&m_store, next.get(), &destroy) != PublishResult::SUCCESS)
+            return false;
+        next.release();
+        return true;
+    }
+
+private:
+    mutable Store<SlotCount, PerCpuReads> m_store;
+};
+
+static_assert(sizeof(Snapshot<int>::ReadGuard) == sizeof(void *));
+
+} // namespace camus
@@ -0,0 +1,1437 @@
+#pragma once
+
+#include <common/utils/AsymmetricFence.h>
+#include <common/utils/Futex.h>
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// This file is based on the following paper:
+// https://dl.acm.org/doi/pdf/10.1145/2851141.2851168
+//
+// Note that the author already opensourced his code at https://github.com/chaoran/fast-wait-free-queue
+
+namespace camus {
+namespace detail::wfqueue {
+
+template <typename T, typename U>
+T cas(std::atomic<T> & c, U expected, T to) {
+    T e = expected;
+    c.compare_exchange_strong(e, to);
+    return e;
+}
+
+struct State {
+    bool pending : 1 = false;
+    int64_t id : 63 = 0;
+
+    bool operator==(const State & other) const { return pending == other.pending && id == other.id; }
+    bool operator!=(const State & other) const { return !(*this == other); }
+};
+static_assert(sizeof(State) == sizeof(int64_t), "");
+
+struct EnqueueReq {
+    // both shared between enqueueSlow and helpEnqueue
+    std::atomic<void *> val = nullptr;
+    std::atomic<State> state;
+
+    // used in enqueueSlow
+    void storeBoth(void * v, State s) {
+        val.store(v);
+        state.store(s);
+    }
+
+    // used in helpEnqueue
+    std::tuple<void *, State> loadBoth() const {
+        // load in reverse order
+        auto s = state.load();
+        auto * v = val.load();
+        return std::make_tuple(v, s);
+    }
+};
+
+struct DequeueReq {
+    // both shared between dequeueSlow and helpDequeue
+    // difference between id and state.id:
+    // - id only changed when start a new request
+    // - state.id changed during the processing of a request
+    std::atomic<int64_t> id = 0;
+    std::atomic<State> state;
+
+    // used in dequeueSlow
+    void storeBoth(int64_t i, State s) {
+        id.store(i);
+        state.store(s);
+    }
+
+    // used in helpEnqueue
+    std::tuple<int64_t, State> loadBoth() const {
+        // load in reverse order
+        auto s = state.load();
+        auto i = id.load();
+        return std::make_tuple(i, s);
+    }
+};
+
+inline char gNeverHolder;
+inline void * const gNeverValue = &gNeverHolder;
+// the value is stored in the cell itself rather than boxed on heap, see `WfQueue::enqueueFast`.
+inline char gInlineHolder;
+inline void * const gInlineValue = &gInlineHolder;
+inline EnqueueReq gNeverEnqHolder;
+inline EnqueueReq * const gNeverEnq = &gNeverEnqHolder;
+inline DequeueReq gNeverDeqHolder;
+inline DequeueReq * const gNeverDeq = &gNeverDeqHolder;
+
+constexpr int64_t CACHE_LINE_SIZE = 64;
+// cheap emptiness checks of `dequeueWait` and `enqueueWait` before parking.
+constexpr int SPIN_COUNT = 64;
+// hazard id of a handle not in any operation.
+constexpr int64_t NO_HAZARD = std::numeric_limits<int64_t>::max();
+// oldestId while a cleanup or a registration is in progress.
+constexpr int64_t CLEANING = -1;
+
+inline void advanceEndForLinearizability(std::atomic<int64_t> * e, int64_t cid) {
+    for (;;) {
+        auto v = e->load();
+        if (v >= cid || cas(*e, v, cid) == v) {
+            break;
+        }
+    }
+}
+
+// newState is the state after this call, no matter whether the claim succeeded.
+inline bool tryToClaimReq(std::atomic<State> * s, int64_t id, int64_t cellId, State * newState) {
+    State expected = {true, id};
+    State to = {false, cellId};
+    *newState = cas(*s, expected, to);
+    if (*newState != expected)
+        return false;
+    *newState = to;
+    return true;
+}
+
+// Written only by the owner thread of a handle, read by anyone. No locked instruction is needed.
+struct Counter {
+    std::atomic<int64_t> n = 0;
+
+    void add(int64_t k) { n.store(n.load(std::memory_order_relaxed) + k, std::memory_order_relaxed); }
+    void inc() { add(1); }
+    int64_t load() const { return n.load(std::memory_order_relaxed); }
+};
+
+} // namespace detail::wfqueue
+
+enum class WfCellLayout {
+    // cells are packed together, neighbours FAAed by different threads may share a cache line.
+    PACKED,
+    // each cell occupies whole cache lines, costs more memory.
+    PADDED,
+    // cells are packed, but consecutive cell ids are mapped to different cache lines of a segment.
+    SCRAMBLED,
+};
+
+enum class WfQueueTopology {
+    MPMC,
+    // only one thread dequeues at a time.
+    MPSC,
+    // only one thread enqueues and one thread dequeues at a time.
+    SPSC,
+};
+
+// Compile-time tunables of `WfQueue`.
+template <int64_t SegmentSize = 64, int64_t Patience = 10, WfCellLayout Layout = WfCellLayout::PACKED,
+          bool AdaptivePatience = false, WfQueueTopology Topology = WfQueueTopology::MPMC>
+struct WfQueuePolicy {
+    static_assert(SegmentSize > 0 && (SegmentSize & (SegmentSize - 1)) == 0, "SegmentSize must be a power of 2");
+    static_assert(Patience >= 0, "");
+
+    // number of cells in a segment.
+    static constexpr int64_t SEGMENT_SIZE = SegmentSize;
+    // extra tries of the fast path before falling into the slow path.
+    static constexpr int64_t PATIENCE = Patience;
+    static constexpr WfCellLayout CELL_LAYOUT = Layout;
+    // each handle starts from PATIENCE, doubles it when the slow path is often taken and decreases it
+    // slowly otherwise, since every failed fast try burns a cell.
+    static constexpr bool ADAPTIVE_PATIENCE = AdaptivePatience;
+    static constexpr WfQueueTopology TOPOLOGY = Topology;
+};
+
+// Event counters of `WfQueue`, see `WfQueue::stats` and `WfQueue::Handle::stats`.
+struct WfQueueStats {
+    // values enqueued and dequeued
+    int64_t enqueues = 0;
+    int64_t dequeues = 0;
+    // dequeues found the queue empty
+    int64_t emptyDequeues = 0;
+    // operations ran out of patience
+    int64_t slowEnqueues = 0;
+    int64_t slowDequeues = 0;
+    // cells marked as 'never' by dequeuers, which are wasted
+    int64_t neverCells = 0;
+    // slow enqueues committed by this dequeuer on behalf of peers (or self)
+    int64_t helpedEnqueues = 0;
+    // pending dequeues of peers this dequeuer helped
+    int64_t helpedDequeues = 0;
+    // segments taken from and given back to the heap, besides the first one of the queue. Their difference is
+    // the number of segments alive.
+    int64_t segmentAllocs = 0;
+    int64_t segmentFrees = 0;
+    // segments reclaimed by cleanup and kept as spares instead of freed
+    int64_t segmentReuses = 0;
+
+    WfQueueStats & operator+=(const WfQueueStats & other) {
+        enqueues += other.enqueues;
+        dequeues += other.dequeues;
+        emptyDequeues += other.emptyDequeues;
+        slowEnqueues += other.slowEnqueues;
+        slowDequeues += other.slowDequeues;
+        neverCells += other.neverCells;
+        helpedEnqueues += other.helpedEnqueues;
+        helpedDequeues += other.helpedDequeues;
+        segmentAllocs += other.segmentAllocs;
+        segmentFrees += other.segmentFrees;
+        segmentReuses += other.segmentReuses;
+        return *this;
+    }
+
+    WfQueueStats & operator-=(const WfQueueStats & other) {
+        enqueues -= other.enqueues;
+        dequeues -= other.dequeues;
+        emptyDequeues -= other.emptyDequeues;
+        slowEnqueues -= other.slowEnqueues;
+        slowDequeues -= other.slowDequeues;
+        neverCells -= other.neverCells;
+        helpedEnqueues -= other.helpedEnqueues;
+        helpedDequeues -= other.helpedDequeues;
+        segmentAllocs -= other.segmentAllocs;
+        segmentFrees -= other.segmentFrees;
+        segmentReuses -= other.segmentReuses;
+        return *this;
+    }
+};
+
+// Wait-free MPMC queue, unbounded unless a capacity is given. Each thread accessing the queue needs its own
+// `Handle`, which registers itself on construction and unregisters on destruction:
+//
+//     WfQueue<int> q;
+//     WfQueue<int>::Handle h(q);
+//     h.enqueue(1);
+//     std::optional<int> v = h.dequeue();
+//
+// Values are moved into the cells directly, only the rare slow path of enqueue boxes them on heap.
+//
+// A bounded queue counts the values in it, `tryEnqueue` fails when the count reaches the capacity and
+// `enqueueWait` sleeps until a dequeue makes room. `enqueue` and `enqueueBulk` wait forever for room there,
+// so nothing exceeds the capacity.
+//
+// With a single consumer (`WfQueueTopology::MPSC` and `SPSC`) there is no one to race the dequeuer, so the
+// helping protocol, the request pointers of cells and the 'never' marks are compiled out. An enqueuer just
+// stores its value, and the dequeuer reports empty when the next cell is not written yet, so values behind
+// a preempted enqueuer are delayed until it finishes. SPSC also updates m_tail without locked instructions.
+// The single-consumer paths have no full barrier in the common case either: the consumer is the only one to
+// run `cleanup`, so it publishes no hazard, and enqueuers publish theirs and look for sleepers behind light
+// fences paired with heavy fences in cleanup and parking, see common/utils/AsymmetricFence.h.
+template <typename T, typename Policy = WfQueuePolicy<>>
+class WfQueue {
+    static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>, "T must be nothrow movable");
+
+    using State = detail::wfqueue::State;
+    using EnqueueReq = detail::wfqueue::EnqueueReq;
+    using DequeueReq = detail::wfqueue::DequeueReq;
+
+    static constexpr auto N = Policy::SEGMENT_SIZE;
+    static constexpr auto PATIENCE = Policy::PATIENCE;
+    // bounds and window of the adaptive patience
+    static constexpr int64_t MAX_PATIENCE = std::max<int64_t>(PATIENCE, 1) * 16;
+    static constexpr int64_t PATIENCE_WINDOW = 1024;
+    static constexpr auto CACHE_LINE_SIZE = detail::wfqueue::CACHE_LINE_SIZE;
+    static constexpr auto NO_HAZARD = detail::wfqueue::NO_HAZARD;
+    static constexpr auto CLEANING = detail::wfqueue::CLEANING;
+    static constexpr bool SINGLE_CONSUMER = Policy::TOPOLOGY != WfQueueTopology::MPMC;
+    static constexpr bool SINGLE_PRODUCER = Policy::TOPOLOGY == WfQueueTopology::SPSC;
+
+    // used by helpers, not needed with a single consumer.
+    struct CellRequests {
+        std::atomic<EnqueueReq *> enq = nullptr;
+        std::atomic<DequeueReq *> deq = nullptr;
+    };
+    struct NoCellRequests {};
+
+    struct alignas(std::max<size_t>(Policy::CELL_LAYOUT == WfCellLayout::PADDED ? CACHE_LINE_SIZE : 1, alignof(T))) Cell
+        : std::conditional_t<SINGLE_CONSUMER, NoCellRequests, CellRequests> {
+        std::atomic<void *> val = nullptr;
+        // holds the value when val is gInlineValue, written only by the enqueuer who FAAed this cell.
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T * value() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    struct Segment {
+        // only changed before the segment is linked.
+        int64_t id = 0;
+        std::atomic<Segment *> next{nullptr};
+        Cell cells[N];
+
+        explicit Segment(int64_t id_)
+            : id(id_) {}
+
+        // prepares a reclaimed segment for reusing.
+        void reset() {
+            next.store(nullptr, std::memory_order_relaxed);
+            for (auto & c : cells) {
+                c.val.store(nullptr, std::memory_order_relaxed);
+                if constexpr (!SINGLE_CONSUMER) {
+                    c.enq.store(nullptr, std::memory_order_relaxed);
+                    c.deq.store(nullptr, std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+
+    struct HandleImpl {
+        // both could be moved forward by `cleanup` of another handle.
+        std::atomic<Segment *> tail;
+        std::atomic<Segment *> head;
+        std::atomic<HandleImpl *> next;
+
+        // segments with id not less than hazardId are in use by this handle.
+        std::atomic<int64_t> hazardId = NO_HAZARD;
+        // ids of tail and head when last enqueue/dequeue finished.
+        int64_t enqSegmentId = 0;
+        int64_t deqSegmentId = 0;
+        // whether a `Handle` owns it. Idle records stay in the ring and are skipped by helpers.
+        std::atomic<bool> active = false;
+        // used to extend the segment list in `findCell`, refilled by `cleanup` or after an operation.
+        std::atomic<Segment *> spare = nullptr;
+
+        // used in helpEnqueue. The peers and requests are kept when the owner leaves, so that the next owner
+        // continues helping from where it stopped.
+        EnqueueReq enqReq;
+        HandleImpl * enqPeer;
+
+        DequeueReq deqReq;
+        HandleImpl * deqPeer;
+
+        // see WfQueueStats
+        struct {
+            detail::wfqueue::Counter enqueues;
+            detail::wfqueue::Counter dequeues;
+            detail::wfqueue::Counter emptyDequeues;
+            detail::wfqueue::Counter slowEnqueues;
+            detail::wfqueue::Counter slowDequeues;
+            detail::wfqueue::Counter neverCells;
+            detail::wfqueue::Counter helpedEnqueues;
+            detail::wfqueue::Counter helpedDequeues;
+            detail::wfqueue::Counter segmentAllocs;
+            detail::wfqueue::Counter segmentFrees;
+            detail::wfqueue::Counter segmentReuses;
+        } counters;
+
+        // used by the adaptive patience, only touched by the owner.
+        int64_t patience = PATIENCE;
+        int64_t windowOps = 0;
+        int64_t windowSlows = 0;
+
+        WfQueueStats stats() const {
+            return {
+                .enqueues = counters.enqueues.load(),
+                .dequeues = counters.dequeues.load(),
+                .emptyDequeues = counters.emptyDequeues.load(),
+                .slowEnqueues = counters.slowEnqueues.load(),
+                .slowDequeues = counters.slowDequeues.load(),
+                .neverCells = counters.neverCells.load(),
+                .helpedEnqueues = counters.helpedEnqueues.load(),
+                .helpedDequeues = counters.helpedDequeues.load(),
+                .segmentAllocs = counters.segmentAllocs.load(),
+                .segmentFrees = counters.segmentFrees.load(),
+                .segmentReuses = counters.segmentReuses.load(),
+            };
+        }
+    };
+
+public:
+    class Handle {
+    public:
+        explicit Handle(WfQueue & q)
+            : m_queue(q)
+            , m_impl(q.registerHandle())
+            , m_base(m_impl->stats()) {}
+
+        ~Handle() { m_queue.unregisterHandle(m_impl); }
+
+        Handle(const Handle &) = delete;
+        Handle & operator=(const Handle &) = delete;
+
+        // Sleeps until the queue is not full if it is bounded.
+        void enqueue(T v) {
+            if (m_queue.bounded())
+                m_queue.reserveWait(1, std::chrono::nanoseconds::max());
+            m_queue.enqueue(m_impl, std::move(v));
+        }
+
+        // Fails if the queue is full, v is untouched then.
+        bool tryEnqueue(T && v) {
+            if (!m_queue.tryReserve())
+                return false;
+            m_queue.enqueue(m_impl, std::move(v));
+            return true;
+        }
+
+        // Sleeps until the queue is not full. Returns false on timeout, v is untouched then. nanoseconds::max()
+        // waits forever.
+        bool enqueueWait(T && v, std::chrono::nanoseconds timeout) {
+            if (!m_queue.reserveWait(1, timeout))
+                return false;
+            m_queue.enqueue(m_impl, std::move(v));
+            return true;
+        }
+
+        // Returns std::nullopt if the queue is empty.
+        std::optional<T> dequeue() { return m_queue.dequeue(m_impl); }
+
+        // Spins for a while then sleeps until a value is enqueued. Returns std::nullopt on timeout,
+        // nanoseconds::max() waits forever.
+        std::optional<T> dequeueWait(std::chrono::nanoseconds timeout) { return m_queue.dequeueWait(m_impl, timeout); }
+
+        // Values are moved from. Cheaper than enqueueing one by one since only one FAA on the tail is needed.
+        // Sleeps until there is room for all values if the queue is bounded, see `enqueueBulkWait`.
+        void enqueueBulk(std::span<T> values) {
+            if (m_queue.bounded())
+                m_queue.reserveWait(static_cast<int64_t>(values.size()), std::chrono::nanoseconds::max());
+            m_queue.enqueueBulk(m_impl, values);
+        }
+
+        // Enqueues all values or none: fails if the queue has no room for all of them, values are untouched
+        // then.
+        bool tryEnqueueBulk(std::span<T> values) {
+            if (!m_queue.tryReserve(static_cast<int64_t>(values.size())))
+                return false;
+            m_queue.enqueueBulk(m_impl, values);
+            return true;
+        }
+
+        // Sleeps until there is room for all values. Returns false on timeout, values are untouched then.
+        // values.size() must not exceed the capacity.
+        bool enqueueBulkWait(std::span<T> values, std::chrono::nanoseconds timeout) {
+            if (!m_queue.reserveWait(static_cast<int64_t>(values.size()), timeout))
+                return false;
+            m_queue.enqueueBulk(m_impl, values);
+            return true;
+        }
+
+        // Dequeues at most max values to out, returns the number of them.
+        template <typename OutputIt>
+        size_t dequeueBulk(OutputIt out, size_t max) { return m_queue.dequeueBulk(m_impl, out, max); }
+
+        // Counters of this handle, may be read from any thread.
+        WfQueueStats stats() const {
+            auto res = m_impl->stats();
+            res -= m_base;
+            return res;
+        }
+
+        // Current patience, changes over time if the policy enables adaptive patience.
+        int64_t patience() const { return m_impl->patience; }
+
+    private:
+        WfQueue & m_queue;
+        HandleImpl * m_impl;
+        // counters of the record are accumulated over owners.
+        WfQueueStats m_base;
+    };
+
+    static constexpr int64_t UNBOUNDED = std::numeric_limits<int64_t>::max();
+
+    explicit WfQueue(int64_t capacity = UNBOUNDED)
+        : m_capacity(capacity) {
+        assert(capacity > 0);
+        if constexpr (SINGLE_CONSUMER)
+            asymmetricThreadFenceInit();
+        m_oldest = new Segment(0);
+        // the ring is never empty, so that m_handles never changes.
+        m_handles = newHandleImpl(0);
+        m_handles->next = m_handles;
+        m_handles->enqPeer = m_handles->deqPeer = m_handles;
+        m_handleCount = 1;
+    }
+
+    // Must be called after all handles are destroyed.
+    ~WfQueue() {
+        assert(m_activeCount == 0);
+        // destroy values left in the queue
+        {
+            Handle h(*this);
+            while (h.dequeue()) {
+            }
+        }
+        for (auto * s = m_oldest; s != nullptr;) {
+            auto * next = s->next.load();
+            delete s;
+            s = next;
+        }
+        for (auto i = m_handleCount.load(); i > 0; --i) {
+            auto * next = m_handles->next.load();
+            delete m_handles->spare.load();
+            delete m_handles;
+            m_handles = next;
+        }
+        while (m_pool != nullptr) {
+            auto * next = m_pool->next.load();
+            delete m_pool;
+            m_pool = next;
+        }
+    }
+
+    WfQueue(const WfQueue &) = delete;
+    WfQueue & operator=(const WfQueue &) = delete;
+
+    // Approximate while values are being enqueued or dequeued. Costs two loads and burns no cell, so it is
+    // the way to poll a queue before dequeueing.
+    bool empty() const {
+        // head before tail: seeing tail <= head means the queue was empty when tail was loaded.
+        auto head = m_head.load();
+        return m_tail.load() <= head;
+    }
+
+    // Sum of counters of all handles, including destroyed ones.
+    WfQueueStats stats() const {
+        WfQueueStats res;
+        auto * h = m_handles;
+        for (auto i = m_handleCount.load(); i > 0; --i, h = h->next.load())
+            res += h->stats();
+        return res;
+    }
+
+private:
+    static Segment * newSegment(HandleImpl * h) {
+        h->counters.segmentAllocs.inc();
+        return new Segment(0);
+    }
+
+    static void freeSegment(HandleImpl * h, Segment * s) {
+        h->counters.segmentFrees.inc();
+        delete s;
+    }
+
+    // Position of the k-th cell in a segment.
+    static constexpr int64_t cellIndex(int64_t k) {
+        if constexpr (Policy::CELL_LAYOUT == WfCellLayout::SCRAMBLED) {
+            // cells sharing a cache line
+            constexpr auto perLine = std::max<int64_t>(CACHE_LINE_SIZE / sizeof(Cell), 1);
+            if constexpr (perLine > 1 && N % perLine == 0) {
+                constexpr auto lines = N / perLine;
+                // k, k + 1, ... k + lines - 1 are on different lines.
+                return k % lines * perLine + k / lines;
+            }
+        }
+        return k;
+    }
+
+    static Cell * findCell(HandleImpl * h, Segment ** sp, int64_t cellId) {
+        auto * s = *sp;
+        for (auto i = s->id, sz = cellId / N; i < sz; ++i) {
+            auto * next = s->next.load();
+            if (!next) {
+                auto * tmp = h->spare.exchange(nullptr);
+                if (tmp == nullptr)
+                    tmp = newSegment(h);
+                tmp->id = i + 1;
+                if (detail::wfqueue::cas(s->next, nullptr, tmp) != nullptr) {
+                    // lost the race, keep it for the next time unless cleanup already refilled one.
+                    if (detail::wfqueue::cas(h->spare, nullptr, tmp) != nullptr)
+                        freeSegment(h, tmp);
+                }
+                next = s->next;
+            }
+            s = next;
+        }
+        *sp = s;
+        return &s->cells[cellIndex(cellId % N)];
+    }
+
+    static Cell * findCell(HandleImpl * h, std::atomic<Segment *> * sp, int64_t cellId,
+                           std::memory_order order = std::memory_order_seq_cst) {
+        auto * s = sp->load();
+        auto * c = findCell(h, &s, cellId);
+        sp->store(s, order);
+        return c;
+    }
+
+    static void tunePatience(HandleImpl * h, bool slow) {
+        if constexpr (Policy::ADAPTIVE_PATIENCE) {
+            h->windowSlows += slow;
+            if (++h->windowOps < PATIENCE_WINDOW)
+                return;
+            if (h->windowSlows > 1)
+                h->patience = std::min(h->patience * 2 + 1, MAX_PATIENCE);
+            else if (h->windowSlows == 0 && h->patience > 0)
+                --h->patience;
+            h->windowOps = h->windowSlows = 0;
+        }
+    }
+
+    // Called after an operation is done, so that the allocation is not on the critical path of the next one.
+    // A segment recycled by cleanup is taken first, so that a queue in a steady state stops allocating.
+    void refillSpare(HandleImpl * h) {
+        if (h->spare.load(std::memory_order_relaxed) != nullptr)
+            return;
+        auto * s = m_poolSize.load(std::memory_order_relaxed) > 0 ? tryTakePooled() : nullptr;
+        if (s == nullptr)
+            s = newSegment(h);
+        if (detail::wfqueue::cas(h->spare, nullptr, s) != nullptr)
+            freeSegment(h, s);
+    }
+
+    // Pops a segment of the pool, nullptr if it is empty or its lock is taken. Never waits for the lock, which
+    // is held by cleanup for a while.
+    Segment * tryTakePooled() {
+        auto oid = m_oldestId.load();
+        if (oid == CLEANING || detail::wfqueue::cas(m_oldestId, oid, CLEANING) != oid)
+            return nullptr;
+        auto * s = m_pool;
+        if (s != nullptr) {
+            m_pool = s->next.load(std::memory_order_relaxed);
+            s->next.store(nullptr, std::memory_order_relaxed);
+            m_poolSize.store(m_poolSize.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        }
+        m_oldestId.store(oid);
+        return s;
+    }
+
+    // Moves the value out of a cell claimed by this dequeuer.
+    static T takeValue(Cell * c, void * v) {
+        if (v == detail::wfqueue::gInlineValue) {
+            T t(std::move(*c->value()));
+            c->value()->~T();
+            return t;
+        }
+        auto * box = static_cast<T *>(v);
+        T t(std::move(*box));
+        delete box;
+        return t;
+    }
+
+    void enqCommit(Cell * c, void * v, int64_t cid) {
+        // keep reverse order of `helpEnqueue`
+        // Note that `enqCommit` is only called on slow path, while on fast path m_tail is directly FAAed.
+        detail::wfqueue::advanceEndForLinearizability(&m_tail, cid + 1);
+        c->val.store(v);
+    }
+
+    // Tries to put v into a cell got by FAAing m_tail. v is untouched on failure.
+    static bool enqueueCell(Cell * c, T & v) {
+        // No one else writes c->storage: enqueuers get different cells by FAA, and helpers only commit
+        // boxed values of the slow path to c->val.
+        new (c->storage) T(std::move(v));
+        if constexpr (SINGLE_CONSUMER) {
+            // the dequeuer never marks a cell as 'never'.
+            c->val.store(detail::wfqueue::gInlineValue, std::memory_order_release);
+            return true;
+        }
+        if (detail::wfqueue::cas(c->val, nullptr, detail::wfqueue::gInlineValue) == nullptr)
+            return true;
+        // a dequeuer already marked this cell as 'never', take the value back.
+        v = std::move(*c->value());
+        c->value()->~T();
+        return false;
+    }
+
+    bool enqueueFast(HandleImpl * h, T & v, int64_t * cid) {
+        auto i = m_tail.fetch_add(1);
+        auto * c = findCell(h, &h->tail, i);
+        if (enqueueCell(c, v))
+            return true;
+        *cid = i;
+        return false;
+    }
+
+    void enqueueSlow(HandleImpl * h, void * v, int64_t cellId) {
+        using namespace detail::wfqueue;
+        auto * r = &h->enqReq;
+        r->storeBoth(v, {true, cellId}); // may be seen by peer (helpEnqueue)
+
+        // avoid directly modifying h->tail: gc may be also modifying it.
+        auto * tmpTail = h->tail.load();
+        State s;
+        for (;;) {
+            auto i = m_tail.fetch_add(1);
+            auto * c = findCell(h, &tmpTail, i);
+            // Try to prevent other dequeuers from occupying this cell.
+            // Note that other enqueuers won't touch this cell since all enqueuers are FAA m_tail.
+            if (cas(c->enq, nullptr, r) == nullptr) {
+                // Must cas c->enq then load c->val since dequeuer follows the same order.
+                auto * cv = c->val.load();
+                // Now helpEnqueue won't change c->enq anymore, but some helper may already mark it as 'never'.
+                // In this case enqueuer couldn't write this cell or the value won't be dequeued.
+                // cv could also be v: a helper found r in c->enq and committed it for us.
+                if (cv != gNeverValue) {
+                    // Now we arrive a safe point: (e, r) always ends with a successful enqueue.
+                    // If `tryToClaimReq` failed, there must be a helper have done this.
+                    tryToClaimReq(&r->state, cellId, i, &s);
+                    break;
+                }
+                // one dequeuer already marked this cell as 'never', try again
+            } else {
+                // one dequeuer already chose this cell for helpEnqueue, skip it and try again
+            }
+            // check if someone already helped me.
+            s = r->state.load();
+            if (!s.pending) {
+                break;
+            }
+        }
+        // s is guaranteed loaded just before loop break
+        assert(!s.pending);
+        auto id = s.id;
+        auto * c = findCell(h, &h->tail, id);
+        // publish v to c
+        enqCommit(c, v, id);
+    }
+
+    // Reserves k cells.
+    int64_t claimTail(int64_t k) {
+        if constexpr (SINGLE_PRODUCER) {
+            auto i = m_tail.load(std::memory_order_relaxed);
+            m_tail.store(i + k, std::memory_order_relaxed);
+            return i;
+        } else {
+            return m_tail.fetch_add(k);
+        }
+    }
+
+    void enqueue(HandleImpl * h, T v) {
+        if constexpr (SINGLE_CONSUMER)
+            enqueueSingle(h, std::move(v));
+        else
+            enqueueMulti(h, std::move(v));
+    }
+
+    // Segments with id not less than segmentId are not freed until `unprotect`. With a single consumer, the
+    // only one to run cleanup, the store is ordered by a light fence, which pairs with the heavy one of cleanup.
+    static void protect(HandleImpl * h, int64_t segmentId) {
+        if constexpr (SINGLE_CONSUMER) {
+            h->hazardId.store(segmentId, std::memory_order_relaxed);
+            asymmetricThreadFenceLight();
+        } else {
+            h->hazardId.store(segmentId);
+        }
+    }
+
+    static void unprotect(HandleImpl * h) {
+        h->hazardId.store(NO_HAZARD, SINGLE_CONSUMER ? std::memory_order_release : std::memory_order_seq_cst);
+    }
+
+    // the cell never fails with a single consumer, so no slow path is needed.
+    void enqueueSingle(HandleImpl * h, T v) {
+        protect(h, h->enqSegmentId);
+        enqueueCell(findCell(h, &h->tail, claimTail(1), std::memory_order_release), v);
+        h->counters.enqueues.inc();
+        h->enqSegmentId = h->tail.load(std::memory_order_relaxed)->id;
+        unprotect(h);
+        wakeSleepers();
+        refillSpare(h);
+    }
+
+    void enqueueMulti(HandleImpl * h, T v) {
+        // h->tail may be moved forward by cleanup, but never beyond the hazard.
+        h->hazardId.store(h->enqSegmentId);
+        int64_t cellId = 0;
+        bool done = false;
+        for (auto p = h->patience; !done && p >= 0; --p) {
+            done = enqueueFast(h, v, &cellId);
+        }
+        if (!done) {
+            // always succeed
+            enqueueSlow(h, new T(std::move(v)), cellId);
+            h->counters.slowEnqueues.inc();
+        }
+        h->counters.enqueues.inc();
+        tunePatience(h, !done);
+        h->enqSegmentId = h->tail.load()->id;
+        h->hazardId.store(NO_HAZARD);
+        wakeSleepers();
+        refillSpare(h);
+    }
+
+    // Reserves cells for all values with one FAA. Once a cell is overtaken by dequeuers, the rest values
+    // fall back to `enqueue` to keep their order, the remaining reserved cells will be marked as 'never'.
+    void enqueueBulk(HandleImpl * h, std::span<T> values) {
+        if (values.empty())
+            return;
+        auto k = static_cast<int64_t>(values.size());
+        protect(h, h->enqSegmentId);
+        auto i = claimTail(k);
+        int64_t j = 0;
+        while (j < k && enqueueCell(findCell(h, &h->tail, i + j), values[j]))
+            ++j;
+        h->counters.enqueues.add(j);
+        h->enqSegmentId = h->tail.load()->id;
+        unprotect(h);
+        if (j != 0)
+            wakeSleepers(j);
+        for (; j < k; ++j)
+            enqueue(h, std::move(values[j]));
+    }
+
+    // Only a load if no one is sleeping.
+    // m_tail is FAAed before loading m_sleepers, while a sleeper increases m_sleepers before its last check of
+    // m_tail. So either the sleeper sees the value, or we see the sleeper.
+    // Wakes one sleeper per value, a woken sleeper that finds the value taken goes back to sleep.
+    void wakeSleepers(int64_t k = 1) {
+        if constexpr (SINGLE_CONSUMER) {
+            // m_tail and the value are published by plain or release stores, the sleeper has the heavy fence.
+            asymmetricThreadFenceLight();
+            if (m_sleepers.load(std::memory_order_relaxed) == 0)
+                return;
+        } else if (m_sleepers.load() == 0) {
+            return;
+        }
+        m_wakeups.fetch_add(1);
+        futexWake(&m_wakeups, static_cast<int>(std::min<int64_t>(k, std::numeric_limits<int>::max())));
+    }
+
+    // Only a load if no one is sleeping, see `wakeSleepers`. Wakes one sleeper per place made, or all of them
+    // if one of them waits for several places.
+    void wakeFullSleepers(int64_t k) {
+        if (m_fullSleepers.load() == 0)
+            return;
+        if (m_bulkFullSleepers.load() != 0)
+            k = std::numeric_limits<int64_t>::max();
+        m_spaceWakeups.fetch_add(1);
+        futexWake(&m_spaceWakeups, static_cast<int>(std::min<int64_t>(k, std::numeric_limits<int>::max())));
+    }
+
+    // Calls tryFn until it succeeds or timeout. tryFn may have side effects even when it fails, so it is only
+    // called when the cheap readyFn says it may succeed. Sleepers are counted before the last check, and the
+    // wakeup word is loaded before that, so that a wakeup after the check is never lost. HeavyFence pairs with
+    // wakers behind light fences.
+    template <bool HeavyFence, typename R, typename F>
+    static auto waitFor(std::atomic<uint32_t> & sleepers, std::atomic<uint32_t> & wakeups,
+                        std::chrono::nanoseconds timeout, R && readyFn, F && tryFn) {
+        using namespace std::chrono;
+        for (auto i = 0; i < detail::wfqueue::SPIN_COUNT; ++i) {
+            if (readyFn()) {
+                if (auto r = tryFn())
+                    return r;
+            }
+            _mm_pause();
+        }
+        auto now = steady_clock::now();
+        // saturated, so that nanoseconds::max() waits forever.
+        auto deadline = timeout < steady_clock::time_point::max() - now ? now + timeout : steady_clock::time_point::max();
+        for (;;) {
+            auto w = wakeups.load();
+            sleepers.fetch_add(1);
+            if constexpr (HeavyFence)
+                asymmetricThreadFenceHeavy();
+            decltype(tryFn()) r{};
+            if (readyFn())
+                r = tryFn();
+            auto left = deadline - steady_clock::now();
+            if (!r && left > nanoseconds::zero())
+                futexWait(&wakeups, w, left);
+            sleepers.fetch_sub(1);
+            if (r || left <= nanoseconds::zero())
+                return r;
+        }
+    }
+
+    std::optional<T> dequeueWait(HandleImpl * h, std::chrono::nanoseconds timeout) {
+        return waitFor<SINGLE_CONSUMER>(m_sleepers, m_wakeups, timeout, [&] { return !empty(); }, [&] { return dequeue(h); });
+    }
+
+    bool bounded() const { return m_capacity != UNBOUNDED; }
+
+    // Called when k values are dequeued.
+    void subCount(int64_t k) {
+        if (bounded() && k != 0) {
+            m_count.fetch_sub(k);
+            wakeFullSleepers(k);
+        }
+    }
+
+    // Takes places for k values. A single FAA keeps it wait-free, while concurrent tries may transiently
+    // push the count over capacity and fail each other when the queue is nearly full.
+    bool tryReserve(int64_t k = 1) {
+        if (!bounded())
+            return true;
+        if (m_count.fetch_add(k) <= m_capacity - k)
+            return true;
+        // Undo without waking, or failed tries of sleepers would wake each other forever. Only an undo that
+        // makes room wakes, one per place: a dequeue meanwhile may have woken a sleeper which still saw no
+        // room.
+        auto prev = m_count.fetch_sub(k);
+        if (prev >= m_capacity && prev - k < m_capacity)
+            wakeFullSleepers(m_capacity - (prev - k));
+        return false;
+    }
+
+    bool reserveWait(int64_t k, std::chrono::nanoseconds timeout) {
+        assert(k <= m_capacity);
+        // One place made doesn't let a bulk sleeper in, which would then swallow the wakeup of a sleeper
+        // needing one place. So while bulk sleepers exist, every wakeup wakes all.
+        if (k > 1)
+            m_bulkFullSleepers.fetch_add(1);
+        auto res = waitFor<false>(
+            m_fullSleepers,
+            m_spaceWakeups,
+            timeout,
+            [&] { return m_count.load() <= m_capacity - k; },
+            [&] { return tryReserve(k); });
+        if (k > 1)
+            m_bulkFullSleepers.fetch_sub(1);
+        return res;
+    }
+
+    void * helpEnqueue(HandleImpl * h, Cell * c, int64_t i) {
+        using namespace detail::wfqueue;
+        // try mark an empty cell as 'never'
+        if (auto * cellValue = cas(c->val, nullptr, gNeverValue); cellValue != nullptr) {
+            // c->val could be v or 'never', there won't have way from v to 'nevee' so directly compare is ok.
+            if (cellValue != gNeverValue) {
+                return cellValue;
+            }
+        } else {
+            h->counters.neverCells.inc();
+        }
+        // Now c->val is 'never', try to help an enqueuer for occupying this cell
+        // No enqueuer here, try to help peer
+        auto * enq = c->enq.load();
+        if (enq == nullptr) {
+            auto * p = activePeer(h->enqPeer);
+            auto * r = &p->enqReq;
+            auto s = r->state.load();
+            auto hs = h->enqReq.state.load();
+            // hs.id == s.id means I saw it last round. Try to help this peer.
+            if (hs.id != s.id) {
+                // try next peer
+                h->enqPeer = p = activePeer(p->next);
+                r = &p->enqReq;
+                s = r->state.load();
+            }
+            // s.pending: s really needs help
+            // s.id <= i: this help won't violate linearizability
+            // cas: help succeeded
+            if (s.pending && s.id <= i && (enq = cas(c->enq, nullptr, r)) != nullptr) {
+                // Fail to help current peer, there must someone (enqueuer or dequeuer) is doing the same thing.
+                // Break and try to help this enq.
+                // Record s.id for next `helpEnqueue`
+                h->enqReq.state.store({false, s.id});
+            } else {
+                // This peer needn't help or the cas already succeeded.
+                // In both scenes we could move to next peer.
+                h->enqPeer = p->next;
+            }
+            if (enq == nullptr) {
+                // Try to mask this cell as 'never'
+                enq = cas(c->enq, nullptr, gNeverEnq);
+                if (enq == nullptr)
+                    enq = gNeverEnq;
+            }
+        }
+        // If enq is 'never' then no enqueuer will enter here.
+        if (enq == gNeverEnq) {
+            // m_tail <= i means the dequeuer is too ahead of enqueuers and don't worth to retry.
+            // m_tail > i means the dequeuer could continue to search for a candidate.
+            return m_tail.load() <= i ? nullptr : gNeverValue;
+        }
+        auto [v, s] = enq->loadBoth();
+        // s.id > i means the enqueuer already skipped this cell
+        if (s.id > i) {
+            // must fetch val then tail, keep reserve order of `enqCommit`
+            // same as the previous if
+            // c->val may not be 'never': enq is reused by a new request, the old one could be committed to c.
+            auto * cv = c->val.load();
+            if (cv == gNeverValue && m_tail.load() <= i)
+                return nullptr;
+            else
+                return cv;
+        } else if (tryToClaimReq(&enq->state, s.id, i, &s)) {
+            // claim succeeds, continue commit.
+            enqCommit(c, v, i);
+            h->counters.helpedEnqueues.inc();
+            return v;
+        } else if (s == State{false, i} && c->val.load() == gNeverValue) {
+            // claim failed and another guy also claimed i and they hasn't finished commit.
+            // Try to help they.
+            enqCommit(c, v, i);
+            h->counters.helpedEnqueues.inc();
+            return v;
+        } else {
+            // claim failed and another guy claimed a different value, return the new value.
+            return c->val.load();
+        }
+    }
+
+    // note that multiple dequeuers may be working on the same Handle.
+    void helpDequeue(HandleImpl * h, HandleImpl * helpee) {
+        using namespace detail::wfqueue;
+        auto * r = &helpee->deqReq;
+        auto [id, s] = r->loadBoth();
+        // !s.pending: s needn't help
+        // s.id < id: s falls behind and we can't help they.
+        if (!s.pending || s.id < id)
+            return;
+        // Share helpee's hazard before touching its segments. The request is still pending after that means
+        // the hazard was published before helpee finished, so it is seen by any cleanup, see `cleanup`.
+        if (h != helpee) {
+            h->hazardId.store(helpee->hazardId.load());
+            s = r->state.load();
+            if (!s.pending || r->id.load() != id)
+                return;
+            h->counters.helpedDequeues.inc();
+        }
+        auto * ha = helpee->head.load(); // avoid directly modify peer's head
+        // prior is a flag for acknowledging changes to s.id
+        auto prior = id;
+        // i: last searched id (may be or may not be cand)
+        auto i = id;
+        int64_t cand = 0;
+        for (;;) {
+            // s.id != prior: there are two change points, one at `dequeueSlow` which denotes a new request,
+            //   one at below denotes a candidate is found. In neither case should we continue the search.
+            for (auto * hc = ha; !cand && s.id == prior;) {
+                auto * c = findCell(h, &hc, ++i);
+                auto * v = helpEnqueue(h, c, i);
+                // v == nullptr: no enqueuers reached i. Waiting is left to `dequeueWait`, out of the algorithm.
+                // v has value and seems no other dequeuers claimed v, try to claim it.
+                if (v == nullptr || (v != gNeverValue && c->deq.load() == nullptr))
+                    cand = i;
+                else
+                    // check if s is changed, see above
+                    s = r->state.load();
+            }
+            if (cand) {
+                // Claim r's target is cand now. Also interrupt other helpers.
+                cas(r->state, State{true, prior}, {true, cand});
+                s = r->state.load();
+            }
+            // !s.pending: helpee already finished.
+            // r->id != id: helpee started a new request.
+            if (!s.pending || r->id.load() != id)
+                return;
+            auto * c = findCell(h, &ha, s.id);
+            // c->val == gNeverValue: terminal status, c is over.
+            // cas succeed: claimed succeed.
+            // c->deq == r: another helper did what we intend to do.
+            if (c->val == gNeverValue || cas(c->deq, nullptr, r) == nullptr || c->deq.load() == r) {
+                // finish this request
+                cas(r->state, s, {false, s.id});
+                return;
+            }
+            // cand == 0 or i
+            // i > prior
+            // s.id could be cand or another cand from another helpee.
+            // persistent s.id to prior for check at L304.
+            // the if is to ensure the monotonicity of our search.
+            prior = s.id;
+            if (s.id >= i) {
+                cand = 0;
+                i = s.id;
+            }
+        }
+    }
+
+    // Tries to claim the value of cell i got by FAAing m_head.
+    void * dequeueCell(HandleImpl * h, Cell * c, int64_t i) {
+        using namespace detail::wfqueue;
+        auto * v = helpEnqueue(h, c, i);
+        // nullptr means the current dequeuer is ahead of all enqueuers.
+        // Return nullptr means this call failed but this cell is revisitable.
+        if (v == nullptr)
+            return nullptr;
+        // v == gNeverValue: this cell is marked as 'never', skip it.
+        // cas fail: a dequeuer already working on this cell, skip it.
+        if (v != gNeverValue && cas(c->deq, nullptr, gNeverDeq) == nullptr)
+            return v;
+        return gNeverValue;
+    }
+
+    std::tuple<int64_t, Cell *, void *> dequeueFast(HandleImpl * h) {
+        auto i = m_head.fetch_add(1);
+        auto * c = findCell(h, &h->head, i);
+        return {i, c, dequeueCell(h, c, i)};
+    }
+
+    std::tuple<Cell *, void *> dequeueSlow(HandleImpl * h, int64_t cid) {
+        using namespace detail::wfqueue;
+        auto * r = &h->deqReq;
+        // claim self as help needed
+        r->storeBoth(cid, {true, cid});
+        // help self
+        helpDequeue(h, h);
+        // r contains the result of `helpDequeue`
+        auto i = r->state.load().id;
+        auto * c = findCell(h, &h->head, i);
+        auto * v = c->val.load();
+        // cells before i+1 are all scaned. Note that in the fast path m_head is directly FAAed.
+        advanceEndForLinearizability(&m_head, i + 1);
+        // if v is still invalid, that means the dequeuer is ahead of all enqueuers. Return empty
+        return {c, v == gNeverValue ? nullptr : v};
+    }
+
+    // Only the single consumer touches m_head, which is never moved beyond an unwritten cell. It is also the
+    // only one to run cleanup, so it needs no hazard.
+    std::optional<T> dequeueSingle(HandleImpl * h) {
+        std::optional<T> res;
+        auto i = m_head.load(std::memory_order_relaxed);
+        if (i < m_tail.load(std::memory_order_acquire)) {
+            auto * c = findCell(h, &h->head, i, std::memory_order_relaxed);
+            // nullptr: the enqueuer of this cell is still writing.
+            if (auto * v = c->val.load(std::memory_order_acquire); v != nullptr) {
+                res.emplace(takeValue(c, v));
+                m_head.store(i + 1, std::memory_order_relaxed);
+            }
+        }
+        h->deqSegmentId = h->head.load(std::memory_order_relaxed)->id;
+        if (res) {
+            subCount(1);
+            h->counters.dequeues.inc();
+        } else {
+            h->counters.emptyDequeues.inc();
+        }
+        cleanup(h);
+        refillSpare(h);
+        return res;
+    }
+
+    std::optional<T> dequeue(HandleImpl * h) {
+        if constexpr (SINGLE_CONSUMER)
+            return dequeueSingle(h);
+        else
+            return dequeueMulti(h);
+    }
+
+    std::optional<T> dequeueMulti(HandleImpl * h) {
+        using namespace detail::wfqueue;
+        // h->head may be moved forward by cleanup, but never beyond the hazard.
+        h->hazardId.store(h->deqSegmentId);
+        void * v = nullptr;
+        Cell * c = nullptr;
+        int64_t cellId = 0;
+        for (auto p = h->patience; p >= 0; --p) {
+            std::tie(cellId, c, v) = dequeueFast(h);
+            // gNeverValue means we need to find for next cell
+            if (v != gNeverValue)
+                break;
+        }
+        auto slow = v == gNeverValue;
+        if (slow) {
+            std::tie(c, v) = dequeueSlow(h, cellId); // lost PATIENCE
+            h->counters.slowDequeues.inc();
+        }
+        tunePatience(h, slow);
+        std::optional<T> res;
+        // c is still protected by the hazard.
+        if (v != nullptr) {
+            res.emplace(takeValue(c, v));
+            subCount(1);
+            h->counters.dequeues.inc();
+        } else {
+            h->counters.emptyDequeues.inc();
+        }
+        // must be recorded before helping peer, which replaces the hazard.
+        h->deqSegmentId = h->head.load()->id;
+        // got value, do not return too early, try to help peer
+        if (v != nullptr) {
+            h->deqPeer = activePeer(h->deqPeer);
+            helpDequeue(h, h->deqPeer);
+            h->deqPeer = h->deqPeer->next;
+        }
+        h->hazardId.store(NO_HAZARD);
+        cleanup(h);
+        refillSpare(h);
+        return res;
+    }
+
+    template <typename OutputIt>
+    size_t dequeueBulk(HandleImpl * h, OutputIt out, size_t max) {
+        if (max == 0)
+            return 0;
+        if constexpr (SINGLE_CONSUMER) {
+            // no FAA to save
+            size_t n = 0;
+            for (; n < max; ++n) {
+                auto v = dequeueSingle(h);
+                if (!v)
+                    break;
+                *out++ = std::move(*v);
+            }
+            return n;
+        } else {
+            return dequeueBulkMulti(h, out, max);
+        }
+    }
+
+    // Reserves cells with one FAA, at most as many as the queue looked to hold, so that polling an empty
+    // queue burns no cells. All reserved cells must be visited even if the queue looks empty by then,
+    // otherwise a value enqueued to a skipped cell later is lost. Falls back to `dequeue` if all cells are
+    // overtaken by enqueuers, so that it makes progress as `dequeue` does.
+    template <typename OutputIt>
+    size_t dequeueBulkMulti(HandleImpl * h, OutputIt out, size_t max) {
+        using namespace detail::wfqueue;
+        // head before tail: seeing tail <= head means the queue was empty when tail was loaded.
+        auto head = m_head.load();
+        auto k = std::min(static_cast<int64_t>(max), m_tail.load() - head);
+        if (k <= 0) {
+            h->counters.emptyDequeues.inc();
+            return 0;
+        }
+        h->hazardId.store(h->deqSegmentId);
+        auto i = m_head.fetch_add(k);
+        size_t n = 0;
+        bool empty = false;
+        for (int64_t j = 0; j < k; ++j) {
+            auto * c = findCell(h, &h->head, i + j);
+            auto * v = dequeueCell(h, c, i + j);
+            if (v == nullptr) {
+                empty = true;
+            } else if (v != gNeverValue) {
+                *out++ = takeValue(c, v);
+                ++n;
+            }
+        }
+        h->deqSegmentId = h->head.load()->id;
+        if (n != 0) {
+            h->deqPeer = activePeer(h->deqPeer);
+            helpDequeue(h, h->deqPeer);
+            h->deqPeer = h->deqPeer->next;
+        }
+        h->hazardId.store(NO_HAZARD);
+        cleanup(h);
+        refillSpare(h);
+        subCount(static_cast<int64_t>(n));
+        h->counters.dequeues.add(static_cast<int64_t>(n));
+        if (n == 0 && empty)
+            h->counters.emptyDequeues.inc();
+        if (n == 0 && !empty) {
+            if (auto v = dequeue(h)) {
+                *out++ = std::move(*v);
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // Returns the segment with id `bound` if it is older than cur.
+    static Segment * lowerSegment(Segment * cur, int64_t bound, Segment * old) {
+        if (bound < cur->id) {
+            auto * s = old;
+            while (s->id < bound)
+                s = s->next.load();
+            cur = s;
+        }
+        return cur;
+    }
+
+    // Returns the oldest segment that can't be freed considering hazard `hp`.
+    static Segment * checkHazard(std::atomic<int64_t> * hp, Segment * cur, Segment * old) {
+        return lowerSegment(cur, hp->load(), old);
+    }
+
+    // Moves the segment pointer `sp` of a handle to at least `cur`, returns the oldest segment that can't be freed.
+    static Segment * updateSegment(std::atomic<Segment *> * sp, Segment * cur, std::atomic<int64_t> * hp, Segment * old) {
+        auto * s = sp->load();
+        if (s->id < cur->id) {
+            // cas fail: the owner moved it concurrently, maybe still behind cur.
+            if (!sp->compare_exchange_strong(s, cur) && s->id < cur->id)
+                cur = s;
+            // the owner may start an operation with an old hazard, check it after moving the pointer.
+            cur = checkHazard(hp, cur, old);
+        }
+        return cur;
+    }
+
+    // Frees segments that all handles have moved past. It only runs when there are enough garbage,
+    // and at most one handle could do it at a time.
+    void cleanup(HandleImpl * h) {
+        auto oid = m_oldestId.load(std::memory_order_relaxed);
+        // h->head is not protected now, use the recorded id instead.
+        if (oid == CLEANING || h->deqSegmentId - oid < 2 * m_handleCount.load(std::memory_order_relaxed))
+            return;
+        if (detail::wfqueue::cas(m_oldestId, oid, CLEANING) != oid)
+            return;
+
+        // no segment could be freed until we release the lock.
+        auto * old = m_oldest;
+        // A handle starting an operation after its hazard is checked will get cells from m_tail or m_head,
+        // its segment pointers must not be moved beyond them, or `findCell` can't go back.
+        auto * cur = lowerSegment(h->head.load(), std::min(m_tail.load(), m_head.load()) / N, old);
+        auto * p = h;
+        do {
+            cur = checkHazard(&p->hazardId, cur, old);
+            cur = updateSegment(&p->tail, cur, &p->hazardId, old);
+            cur = updateSegment(&p->head, cur, &p->hazardId, old);
+            p = p->next.load();
+        } while (cur->id > oid && p != h);
+        // A helper copies its helpee's hazard then checks the helpee is still running. If the helper is
+        // scanned before the copy and the helpee is scanned after it finished, the hazard is missed.
+        // Scan all hazards again to ensure the copied one is seen.
+        // With a single consumer, enqueuers publish hazards behind light fences, which are ordered before the
+        // second scan by the heavy one.
+        if constexpr (SINGLE_CONSUMER)
+            asymmetricThreadFenceHeavy();
+        do {
+            cur = checkHazard(&p->hazardId, cur, old);
+            p = p->next.load();
+        } while (cur->id > oid && p != h);
+
+        if (cur->id <= oid) {
+            m_oldestId.store(oid);
+            return;
+        }
+        m_oldest = cur;
+        // Recycle reclaimed segments: refill spares of handles first, then the pool for registrations,
+        // and delete the rest.
+        auto handleCount = m_handleCount.load();
+        auto unvisited = handleCount;
+        while (old != cur) {
+            auto * next = old->next.load();
+            while (unvisited > 0 && p->spare.load() != nullptr) {
+                p = p->next.load();
+                --unvisited;
+            }
+            if (unvisited > 0 || m_poolSize.load(std::memory_order_relaxed) < 2 * handleCount) {
+                h->counters.segmentReuses.inc();
+                old->reset();
+                // cas fail: the owner just refilled it.
+                if (unvisited == 0 || detail::wfqueue::cas(p->spare, nullptr, old) != nullptr) {
+                    old->next.store(m_pool, std::memory_order_relaxed);
+                    m_pool = old;
+                    m_poolSize.store(m_poolSize.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                }
+            } else {
+                freeSegment(h, old);
+            }
+            old = next;
+        }
+        m_oldestId.store(cur->id);
+    }
+
+    // Returns the first active handle from p, or p if all are idle. Idle handles have no pending request.
+    HandleImpl * activePeer(HandleImpl * p) const {
+        auto * res = p;
+        for (auto i = m_handleCount.load(std::memory_order_relaxed); i > 0; --i, res = res->next.load()) {
+            if (res->active.load(std::memory_order_relaxed))
+                return res;
+        }
+        return p;
+    }
+
+    // Takes the lock of m_oldest and the handle ring, returns id of m_oldest.
+    int64_t lockOldest() {
+        for (;;) {
+            auto oid = m_oldestId.load();
+            if (oid != CLEANING && detail::wfqueue::cas(m_oldestId, oid, CLEANING) == oid)
+                return oid;
+            _mm_pause();
+        }
+    }
+
+    // A record whose segment pointers start from m_oldest, which must be protected by the caller.
+    HandleImpl * newHandleImpl(int64_t oid) {
+        auto * h = new HandleImpl;
+        h->tail = m_oldest;
+        h->head = m_oldest;
+        h->enqSegmentId = h->deqSegmentId = oid;
+        if (m_pool != nullptr) {
+            auto * s = m_pool;
+            m_pool = s->next.load(std::memory_order_relaxed);
+            s->next.store(nullptr, std::memory_order_relaxed);
+            m_poolSize.store(m_poolSize.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+            h->spare = s;
+        } else {
+            h->spare = newSegment(h);
+        }
+        return h;
+    }
+
+    // Claims an idle record of the ring if any, which is wait-free. Records never leave the ring since peers
+    // may be visiting them, and cleanup keeps moving their segment pointers, so a claimed record is ready to
+    // use. Only when all records are busy a new one is linked, under the lock of m_oldestId since cleanup
+    // requires tail and head of all records in the ring valid.
+    HandleImpl * registerHandle() {
+        auto * h = m_handles;
+        for (auto i = m_handleCount.load(); i > 0; --i, h = h->next.load()) {
+            auto idle = false;
+            if (!h->active.load(std::memory_order_relaxed) && h->active.compare_exchange_strong(idle, true)) {
+                h->patience = PATIENCE;
+                h->windowOps = h->windowSlows = 0;
+                ++m_activeCount;
+                return h;
+            }
+        }
+
+        auto oid = lockOldest();
+        h = newHandleImpl(oid);
+        h->active = true;
+        h->next = m_handles->next.load();
+        h->enqPeer = h->deqPeer = h->next;
+        // readers walking the ring see h either linked completely or not at all.
+        m_handles->next = h;
+        ++m_handleCount;
+        ++m_activeCount;
+        m_oldestId.store(oid);
+        return h;
+    }
+
+    // Wait-free. The record keeps its spare segment for the next owner, and its segment pointers are moved
+    // by cleanup of others, so nothing is held back.
+    void unregisterHandle(HandleImpl * h) {
+        h->active.store(false);
+        --m_activeCount;
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_tail = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_head = 0;
+
+    // used in dequeueWait, read by every enqueue.
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_sleepers = 0;
+    // futex word, bumped when sleepers should recheck the queue.
+    std::atomic<uint32_t> m_wakeups = 0;
+
+    // used in bounded queues
+    const int64_t m_capacity;
+    // values enqueued but not dequeued, plus pending `tryReserve`s.
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_count = 0;
+    // same as m_sleepers and m_wakeups, for enqueueWait.
+    std::atomic<uint32_t> m_fullSleepers = 0;
+    std::atomic<uint32_t> m_spaceWakeups = 0;
+    // sleepers of `reserveWait` for more than one place.
+    std::atomic<uint32_t> m_bulkFullSleepers = 0;
+
+    // used in cleanup
+    alignas(CACHE_LINE_SIZE)
+    // id of m_oldest, or CLEANING which works as a lock for m_oldest and the handle ring.
+    std::atomic<int64_t> m_oldestId = 0;
+    Segment * m_oldest = nullptr;
+    // any handle of the ring, set on construction.
+    HandleImpl * m_handles = nullptr;
+    std::atomic<int64_t> m_handleCount = 0;
+    std::atomic<int64_t> m_activeCount = 0;
+    // reclaimed segments for reusing, linked by next, guarded by the lock of m_oldestId. The size is also read
+    // without the lock, to skip taking it for an empty pool.
+    Segment * m_pool = nullptr;
+    std::atomic<int64_t> m_poolSize = 0;
+};
+
+template <typename T>
+using WfMpscQueue = WfQueue<T, WfQueuePolicy<64, 10, WfCellLayout::PACKED, false, WfQueueTopology::MPSC>>;
+
+template <typename T>
+using WfSpscQueue = WfQueue<T, WfQueuePolicy<64, 10, WfCellLayout::PACKED, false, WfQueueTopology::SPSC>>;
+
+} // namespace camus
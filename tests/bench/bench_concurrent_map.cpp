@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include <common/container/ConcurrentFlatMap.h>
+#include <common/spinlock/rw_spinlock.h>
+#include <common/spinlock/nginx_spinlock.h>
+#include <robin_hood.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Compares ConcurrentFlatMap with a robin_hood map behind one global std::mutex or std::shared_mutex.
+//
+// Threads go from 1 to twice the hardware concurrency, each doing OPS operations on random keys out of KEYS,
+// of which the given percentage are lookups and the rest upserts.
+
+namespace camus::bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t KEYS = 1 << 16;
+constexpr int64_t OPS = 1 << 20;
+
+template <typename Lock>
+struct ShardedAdapter {
+    ConcurrentFlatMap<uint64_t, uint64_t, Lock> m;
+
+    uint64_t find(uint64_t k) const {
+        uint64_t res = 0;
+        m.visit(k, [&](uint64_t v) { res = v; });
+        return res;
+    }
+
+    void upsert(uint64_t k) {
+        m.upsert(k, [](uint64_t & v) { ++v; });
+    }
+};
+
+template <typename Mutex>
+struct GlobalLockAdapter {
+    mutable Mutex mu;
+    robin_hood::unordered_flat_map<uint64_t, uint64_t> m;
+
+    uint64_t find(uint64_t k) const {
+        std::conditional_t<std::is_same_v<Mutex, std::shared_mutex>, std::shared_lock<Mutex>, std::unique_lock<Mutex>> lock(mu);
+        auto it = m.find(k);
+        return it == m.end() ? 0 : it->second;
+    }
+
+    void upsert(uint64_t k) {
+        std::unique_lock lock(mu);
+        ++m[k];
+    }
+};
+
+template <typename M>
+void BM_Map(benchmark::State & state) {
+    const auto threadCount = state.range(0);
+    const auto readPercent = static_cast<uint64_t>(state.range(1));
+    M m;
+    for (uint64_t k = 0; k < KEYS; ++k)
+        m.upsert(k);
+    for (auto _ : state) {
+        std::atomic<bool> go = false;
+        std::vector<std::thread> threads;
+        for (int64_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&, i] {
+                std::mt19937_64 rng(static_cast<uint64_t>(i));
+                while (!go.load())
+                    std::this_thread::yield();
+                uint64_t sum = 0;
+                for (int64_t j = 0; j < OPS; ++j) {
+                    auto r = rng();
+                    auto k = r % KEYS;
+                    if ((r >> 32) % 100 < readPercent)
+                        sum += m.find(k);
+                    else
+                        m.upsert(k);
+                }
+                benchmark::DoNotOptimize(sum);
+            });
+        }
+        auto start = Clock::now();
+        go = true;
+        for (auto & t : threads)
+            t.join();
+        state.SetIterationTime(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    state.SetItemsProcessed(state.iterations() * threadCount * OPS);
+}
+
+void mapArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"threads", "read_pct"});
+    const auto maxThreads = std::max<int64_t>(std::thread::hardware_concurrency(), 1) * 2;
+    for (int64_t n = 1; n <= maxThreads; n *= 2) {
+        for (int64_t pct : {100, 90, 50})
+            b->Args({n, pct});
+    }
+}
+
+#define MAP_BENCH(M) BENCHMARK_TEMPLATE(BM_Map, M)->Apply(mapArgs)->UseManualTime()->Unit(benchmark::kMillisecond)
+
+MAP_BENCH(ShardedAdapter<RwSpinLock>);
+MAP_BENCH(ShardedAdapter<NginxSpinLock>);
+MAP_BENCH(GlobalLockAdapter<std::mutex>);
+MAP_BENCH(GlobalLockAdapter<std::shared_mutex>);
+
+} // namespace
+} // namespace camus::bench
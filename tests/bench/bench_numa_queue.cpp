@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include <common/utils/Numa.h>
+#include <common/waitfree/NumaWfQueue.h>
+#include <common/waitfree/WfQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Compares WfQueue with NumaWfQueue, every thread enqueues then dequeues.
+//
+// Thread i is pinned to NUMA node i % numaNodeCount(), and its NumaWfQueue handle is on shard i % shards.
+// On a single node machine, shards > 1 still shows the effect of splitting m_tail and m_head, though not
+// the cost of crossing sockets.
+
+namespace camus::bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t ITEMS = 1 << 21;
+
+template <typename Q, typename MakeHandle>
+void run(benchmark::State & state, Q & q, MakeHandle && makeHandle) {
+    const auto threads = state.range(0);
+    const auto nodes = numaNodeCount();
+    for (auto _ : state) {
+        std::atomic<bool> go = false;
+        std::vector<std::thread> workers;
+        for (int64_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&, i] {
+                pinToNumaNode(static_cast<int>(i % nodes));
+                auto h = makeHandle(q, i);
+                while (!go.load())
+                    std::this_thread::yield();
+                int64_t v = 0;
+                for (int64_t j = 0; j < ITEMS / threads; ++j) {
+                    h->enqueue(j);
+                    for (;;) {
+                        if (auto r = h->dequeue()) {
+                            v += *r;
+                            break;
+                        }
+                    }
+                }
+                benchmark::DoNotOptimize(v);
+            });
+        }
+        auto start = Clock::now();
+        go = true;
+        for (auto & t : workers)
+            t.join();
+        state.SetIterationTime(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS);
+}
+
+void BM_WfQueue(benchmark::State & state) {
+    WfQueue<int64_t> q;
+    run(state, q, [](auto & q, int64_t) { return std::make_unique<WfQueue<int64_t>::Handle>(q); });
+}
+
+void BM_NumaWfQueue(benchmark::State & state) {
+    const auto shards = state.range(1);
+    NumaWfQueue<int64_t> q(static_cast<int>(shards));
+    run(state, q, [shards](auto & q, int64_t i) {
+        return std::make_unique<NumaWfQueue<int64_t>::Handle>(q, static_cast<int>(i % shards));
+    });
+}
+
+int64_t maxThreads() {
+    return std::max<int64_t>(std::thread::hardware_concurrency(), 1) * 2;
+}
+
+void wfArgs(benchmark::internal::Benchmark * b) {
+    b->ArgName("threads");
+    for (int64_t n = 1; n <= maxThreads(); n *= 2)
+        b->Arg(n);
+}
+
+void numaArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"threads", "shards"});
+    auto shards = std::max<int64_t>(numaNodeCount(), 2);
+    for (int64_t n = 1; n <= maxThreads(); n *= 2) {
+        b->Args({n, numaNodeCount()});
+        if (shards != numaNodeCount())
+            b->Args({n, shards});
+    }
+}
+
+BENCHMARK(BM_WfQueue)->Apply(wfArgs)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_NumaWfQueue)->Apply(numaArgs)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace camus::bench
@@ -0,0 +1,216 @@
+#include <benchmark/benchmark.h>
+#include <boost/lockfree/queue.hpp>
+#include <common/waitfree/WfQueue.h>
+#include <folly/MPMCQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Compares WfQueue with boost::lockfree::queue and folly::MPMCQueue.
+//
+// BM_QueuePairs: every thread enqueues then dequeues.
+// BM_Queue: separate producers and consumers, balanced, producer-heavy and consumer-heavy.
+// The single consumer variants of WfQueue only run with the topologies they support, and BM_QueuePairs with one
+// thread shows their uncontended cost per operation.
+//
+// Thread counts go from 1 to twice the hardware concurrency, so the last runs are oversubscribed.
+// Reports throughput and p50/p99/p999 latency of successful operations.
+
+namespace camus::bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t ITEMS = 1 << 21;
+// capacity of the bounded queues
+constexpr size_t CAPACITY = 1 << 16;
+
+template <typename Q>
+struct WfQueueAdapterT {
+    Q q;
+
+    struct Handle {
+        explicit Handle(WfQueueAdapterT & a)
+            : h(a.q) {}
+
+        bool push(int64_t v) {
+            h.enqueue(v);
+            return true;
+        }
+
+        bool pop(int64_t & v) {
+            auto r = h.dequeue();
+            if (r)
+                v = *r;
+            return r.has_value();
+        }
+
+        typename Q::Handle h;
+    };
+};
+
+using WfQueueAdapter = WfQueueAdapterT<WfQueue<int64_t>>;
+using WfMpscQueueAdapter = WfQueueAdapterT<WfMpscQueue<int64_t>>;
+using WfSpscQueueAdapter = WfQueueAdapterT<WfSpscQueue<int64_t>>;
+
+struct BoostQueueAdapter {
+    boost::lockfree::queue<int64_t> q{CAPACITY};
+
+    struct Handle {
+        explicit Handle(BoostQueueAdapter & a)
+            : q(a.q) {}
+
+        bool push(int64_t v) { return q.push(v); }
+        bool pop(int64_t & v) { return q.pop(v); }
+
+        boost::lockfree::queue<int64_t> & q;
+    };
+};
+
+struct FollyQueueAdapter {
+    folly::MPMCQueue<int64_t> q{CAPACITY};
+
+    struct Handle {
+        explicit Handle(FollyQueueAdapter & a)
+            : q(a.q) {}
+
+        bool push(int64_t v) { return q.write(v); }
+        bool pop(int64_t & v) { return q.read(v); }
+
+        folly::MPMCQueue<int64_t> & q;
+    };
+};
+
+// Latencies in ns of one thread.
+using Samples = std::vector<int64_t>;
+
+template <typename F>
+void timed(Samples & samples, F && op) {
+    for (;;) {
+        auto start = Clock::now();
+        auto ok = op();
+        auto end = Clock::now();
+        if (ok) {
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+template <typename F>
+void run(benchmark::State & state, int64_t threads, F && body) {
+    std::vector<Samples> samples(threads);
+    for (auto _ : state) {
+        std::atomic<bool> go = false;
+        std::vector<std::thread> workers;
+        for (int64_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&, i] {
+                samples[i].clear();
+                samples[i].reserve(ITEMS * 2 / threads + 1);
+                while (!go.load())
+                    std::this_thread::yield();
+                body(i, samples[i]);
+            });
+        }
+        auto start = Clock::now();
+        go = true;
+        for (auto & t : workers)
+            t.join();
+        state.SetIterationTime(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    Samples all;
+    for (auto & s : samples)
+        all.insert(all.end(), s.begin(), s.end());
+    auto percentile = [&](double p) {
+        auto it = all.begin() + static_cast<int64_t>(static_cast<double>(all.size() - 1) * p);
+        std::nth_element(all.begin(), it, all.end());
+        return static_cast<double>(*it);
+    };
+    state.counters["p50_ns"] = percentile(0.5);
+    state.counters["p99_ns"] = percentile(0.99);
+    state.counters["p999_ns"] = percentile(0.999);
+    state.SetItemsProcessed(state.iterations() * ITEMS);
+}
+
+template <typename Q>
+void BM_QueuePairs(benchmark::State & state) {
+    const auto threads = state.range(0);
+    Q q;
+    run(state, threads, [&](int64_t, Samples & samples) {
+        typename Q::Handle h(q);
+        int64_t v = 0;
+        for (int64_t i = 0; i < ITEMS / threads; ++i) {
+            timed(samples, [&] { return h.push(i); });
+            timed(samples, [&] { return h.pop(v); });
+        }
+        benchmark::DoNotOptimize(v);
+    });
+}
+
+template <typename Q>
+void BM_Queue(benchmark::State & state) {
+    const auto producers = state.range(0);
+    const auto consumers = state.range(1);
+    Q q;
+    run(state, producers + consumers, [&](int64_t id, Samples & samples) {
+        typename Q::Handle h(q);
+        if (id < producers) {
+            for (int64_t i = id; i < ITEMS; i += producers)
+                timed(samples, [&] { return h.push(i); });
+        } else {
+            int64_t v = 0;
+            for (int64_t i = id - producers; i < ITEMS; i += consumers)
+                timed(samples, [&] { return h.pop(v); });
+            benchmark::DoNotOptimize(v);
+        }
+    });
+}
+
+int64_t maxThreads() {
+    return std::max<int64_t>(std::thread::hardware_concurrency(), 1) * 2;
+}
+
+void pairsArgs(benchmark::internal::Benchmark * b) {
+    b->ArgName("threads");
+    for (int64_t n = 1; n <= maxThreads(); n *= 2)
+        b->Arg(n);
+}
+
+void mpmcArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"producers", "consumers"});
+    for (int64_t n = 2; n <= maxThreads(); n *= 2) {
+        b->Args({n / 2, n / 2});
+        if (n >= 4) {
+            b->Args({n * 3 / 4, n / 4});
+            b->Args({n / 4, n * 3 / 4});
+        }
+    }
+}
+
+#define QUEUE_BENCH(Q)                                                                                          \
+    BENCHMARK_TEMPLATE(BM_QueuePairs, Q)->Apply(pairsArgs)->UseManualTime()->Unit(benchmark::kMillisecond);    \
+    BENCHMARK_TEMPLATE(BM_Queue, Q)->Apply(mpmcArgs)->UseManualTime()->Unit(benchmark::kMillisecond)
+
+QUEUE_BENCH(WfQueueAdapter);
+QUEUE_BENCH(BoostQueueAdapter);
+QUEUE_BENCH(FollyQueueAdapter);
+
+void mpscArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"producers", "consumers"});
+    for (int64_t n = 1; n < maxThreads(); n *= 2)
+        b->Args({n, 1});
+}
+
+BENCHMARK_TEMPLATE(BM_QueuePairs, WfMpscQueueAdapter)->ArgName("threads")->Arg(1)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_QueuePairs, WfSpscQueueAdapter)->ArgName("threads")->Arg(1)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Queue, WfMpscQueueAdapter)->Apply(mpscArgs)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Queue, WfSpscQueueAdapter)->ArgNames({"producers", "consumers"})->Args({1, 1})->UseManualTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace camus::bench
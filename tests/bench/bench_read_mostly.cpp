@@ -0,0 +1,206 @@
+#include <benchmark/benchmark.h>
+#include <common/waitfree/Snapshot.h>
+#include <folly/synchronization/Hazptr.h>
+#include <folly/synchronization/Rcu.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+// Compares Snapshot (ObjectStorage) with std::atomic<std::shared_ptr>, folly hazptr, folly RCU and a rwlock
+// for read-mostly data.
+//
+// Readers acquire the current value, read it and release it, while one writer publishes a new value at the
+// given rate per second, 0 for none. Readers go from 1 to twice the hardware concurrency.
+// Reports read throughput and p50/p99 latency of publish.
+
+namespace camus::bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int64_t READS = 1 << 20;
+
+struct Value {
+    int64_t version = 0;
+    std::array<int64_t, 7> data = {};
+};
+
+template <bool PerCpuReads>
+struct SnapshotAdapterT {
+    Snapshot<Value, 4, PerCpuReads> s;
+
+    template <typename F>
+    void read(F && f) const {
+        auto r = s.read();
+        f(*r);
+    }
+
+    void publish(const Value & v) { s.publish(v); }
+};
+
+using SnapshotAdapter = SnapshotAdapterT<false>;
+using PerCpuSnapshotAdapter = SnapshotAdapterT<true>;
+
+struct AtomicSharedPtrAdapter {
+    std::atomic<std::shared_ptr<const Value>> p = std::make_shared<const Value>();
+
+    template <typename F>
+    void read(F && f) const {
+        auto r = p.load();
+        f(*r);
+    }
+
+    void publish(const Value & v) { p.store(std::make_shared<const Value>(v)); }
+};
+
+struct HazptrAdapter {
+    struct Node : folly::hazptr_obj_base<Node> {
+        explicit Node(const Value & v_)
+            : v(v_) {}
+
+        Value v;
+    };
+
+    std::atomic<Node *> p = new Node(Value());
+
+    ~HazptrAdapter() {
+        delete p.load();
+        folly::hazptr_cleanup();
+    }
+
+    template <typename F>
+    void read(F && f) const {
+        auto h = folly::make_hazard_pointer<>();
+        f(h.protect(p)->v);
+    }
+
+    void publish(const Value & v) { p.exchange(new Node(v))->retire(); }
+};
+
+struct RcuAdapter {
+    struct Node {
+        Value v;
+    };
+
+    std::atomic<Node *> p = new Node();
+
+    ~RcuAdapter() {
+        folly::rcu_barrier();
+        delete p.load();
+    }
+
+    template <typename F>
+    void read(F && f) const {
+        folly::rcu_reader guard;
+        f(p.load(std::memory_order_acquire)->v);
+    }
+
+    void publish(const Value & v) { folly::rcu_retire(p.exchange(new Node{v}, std::memory_order_acq_rel)); }
+};
+
+struct RwLockAdapter {
+    mutable std::shared_mutex mu;
+    Value v;
+
+    template <typename F>
+    void read(F && f) const {
+        std::shared_lock lock(mu);
+        f(v);
+    }
+
+    void publish(const Value & next) {
+        std::unique_lock lock(mu);
+        v = next;
+    }
+};
+
+template <typename S>
+void BM_ReadMostly(benchmark::State & state) {
+    const auto readers = state.range(0);
+    const auto rate = state.range(1);
+    S s;
+    std::vector<int64_t> latencies;
+    for (auto _ : state) {
+        std::atomic<bool> go = false;
+        std::atomic<int64_t> running = readers;
+        std::vector<std::thread> threads;
+        for (int64_t i = 0; i < readers; ++i) {
+            threads.emplace_back([&] {
+                while (!go.load())
+                    std::this_thread::yield();
+                int64_t sum = 0;
+                for (int64_t j = 0; j < READS; ++j)
+                    s.read([&](const Value & v) { sum += v.version + v.data[j % 7]; });
+                benchmark::DoNotOptimize(sum);
+                --running;
+            });
+        }
+        if (rate > 0) {
+            threads.emplace_back([&] {
+                while (!go.load())
+                    std::this_thread::yield();
+                const auto period = std::chrono::nanoseconds(1000000000 / rate);
+                auto next = Clock::now();
+                Value v;
+                while (running.load() > 0) {
+                    ++v.version;
+                    auto start = Clock::now();
+                    s.publish(v);
+                    latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+                    next += period;
+                    std::this_thread::sleep_until(next);
+                }
+            });
+        }
+        auto start = Clock::now();
+        go = true;
+        for (auto & t : threads)
+            t.join();
+        state.SetIterationTime(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * readers * READS);
+    if (!latencies.empty()) {
+        auto percentile = [&](double p) {
+            auto it = latencies.begin() + static_cast<int64_t>(static_cast<double>(latencies.size() - 1) * p);
+            std::nth_element(latencies.begin(), it, latencies.end());
+            return static_cast<double>(*it);
+        };
+        state.counters["publish_p50_ns"] = percentile(0.5);
+        state.counters["publish_p99_ns"] = percentile(0.99);
+        state.counters["publishes"] = static_cast<double>(latencies.size());
+    }
+}
+
+int64_t maxThreads() {
+    return std::max<int64_t>(std::thread::hardware_concurrency(), 1) * 2;
+}
+
+void readMostlyArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"readers", "updates_per_sec"});
+    for (int64_t n = 1; n <= maxThreads(); n *= 2) {
+        for (int64_t rate : {0, 100, 1000, 10000})
+            b->Args({n, rate});
+    }
+}
+
+#define READ_MOSTLY_BENCH(S) \
+    BENCHMARK_TEMPLATE(BM_ReadMostly, S)->Apply(readMostlyArgs)->UseManualTime()->Unit(benchmark::kMillisecond)
+
+READ_MOSTLY_BENCH(SnapshotAdapter);
+READ_MOSTLY_BENCH(PerCpuSnapshotAdapter);
+READ_MOSTLY_BENCH(AtomicSharedPtrAdapter);
+READ_MOSTLY_BENCH(HazptrAdapter);
+READ_MOSTLY_BENCH(RcuAdapter);
+READ_MOSTLY_BENCH(RwLockAdapter);
+
+} // namespace
+} // namespace camus::bench
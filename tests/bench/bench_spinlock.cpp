@@ -0,0 +1,148 @@
+#include <benchmark/benchmark.h>
+#include <common/spinlock/adaptive_spinlock.h>
+#include <common/spinlock/clh_spinlock.h>
+#include <common/spinlock/cohort_spinlock.h>
+#include <common/spinlock/mcs_spinlock.h>
+#include <common/spinlock/nginx_spinlock.h>
+#include <common/spinlock/rw_spinlock.h>
+#include <common/spinlock/ticket_spinlock.h>
+#include <common/spinlock/trivial_exchange_spinlock.h>
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Compares the spinlocks with std::mutex, sweeping threads, critical section length and think time, both
+// in _mm_pause iterations. Each run lasts DURATION.
+//
+// Reports acquisitions per second, fairness as the relative stddev of per-thread acquisitions (0 is fair),
+// and p50/p99 handoff latency, the time from an unlock to the lock taken by another thread.
+
+namespace camus::bench {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto DURATION = std::chrono::milliseconds(200);
+
+void spin(int64_t n) {
+    for (int64_t i = 0; i < n; ++i)
+        _mm_pause();
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+template <typename Lock>
+void BM_Lock(benchmark::State & state) {
+    const auto threads = state.range(0);
+    const auto csLength = state.range(1);
+    const auto think = state.range(2);
+    Lock lk;
+    std::vector<int64_t> acquisitions(threads);
+    std::vector<std::vector<int64_t>> handoffs(threads);
+    // protected by lk
+    int64_t owner = -1;
+    int64_t releasedAt = 0;
+
+    for (auto _ : state) {
+        std::atomic<bool> go = false;
+        std::atomic<bool> stop = false;
+        std::vector<std::thread> workers;
+        for (int64_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&, i] {
+                // counted locally and stored once: adjacent slots would be falsely shared between workers.
+                int64_t acquired = 0;
+                std::vector<int64_t> waits;
+                while (!go.load())
+                    std::this_thread::yield();
+                while (!stop.load(std::memory_order_relaxed)) {
+                    lk.lock();
+                    if (owner != i && owner != -1)
+                        waits.push_back(nowNs() - releasedAt);
+                    spin(csLength);
+                    owner = i;
+                    releasedAt = nowNs();
+                    lk.unlock();
+                    ++acquired;
+                    spin(think);
+                }
+                acquisitions[i] = acquired;
+                handoffs[i] = std::move(waits);
+            });
+        }
+        auto start = Clock::now();
+        go = true;
+        std::this_thread::sleep_for(DURATION);
+        stop = true;
+        for (auto & t : workers)
+            t.join();
+        state.SetIterationTime(std::chrono::duration<double>(Clock::now() - start).count());
+        owner = -1;
+    }
+
+    int64_t total = 0;
+    for (auto a : acquisitions)
+        total += a;
+    auto mean = static_cast<double>(total) / static_cast<double>(threads);
+    double variance = 0;
+    for (auto a : acquisitions)
+        variance += (static_cast<double>(a) - mean) * (static_cast<double>(a) - mean);
+    variance /= static_cast<double>(threads);
+
+    std::vector<int64_t> all;
+    for (auto & h : handoffs)
+        all.insert(all.end(), h.begin(), h.end());
+    auto percentile = [&](double p) {
+        if (all.empty())
+            return 0.0;
+        auto it = all.begin() + static_cast<int64_t>(static_cast<double>(all.size() - 1) * p);
+        std::nth_element(all.begin(), it, all.end());
+        return static_cast<double>(*it);
+    };
+
+    // counts of the last iteration
+    state.SetItemsProcessed(state.iterations() * total);
+    state.counters["fairness_rsd"] = mean == 0 ? 0 : std::sqrt(variance) / mean;
+    state.counters["handoff_p50_ns"] = percentile(0.5);
+    state.counters["handoff_p99_ns"] = percentile(0.99);
+}
+
+int64_t maxThreads() {
+    return std::max<int64_t>(std::thread::hardware_concurrency(), 1) * 2;
+}
+
+void lockArgs(benchmark::internal::Benchmark * b) {
+    b->ArgNames({"threads", "cs", "think"});
+    for (int64_t n = 1; n <= maxThreads(); n *= 2) {
+        for (int64_t cs : {0, 100, 1000}) {
+            for (int64_t think : {0, 1000})
+                b->Args({n, cs, think});
+        }
+    }
+}
+
+#define LOCK_BENCH(Lock) \
+    BENCHMARK_TEMPLATE(BM_Lock, Lock)->Apply(lockArgs)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond)
+
+LOCK_BENCH(TrivialSpinLock);
+LOCK_BENCH(NginxSpinLock);
+LOCK_BENCH(TicketSpinLock);
+LOCK_BENCH(McsSpinLock);
+LOCK_BENCH(ClhSpinLock);
+LOCK_BENCH(AdaptiveSpinLock);
+LOCK_BENCH(RwSpinLock);
+LOCK_BENCH(BrSpinLock);
+LOCK_BENCH(CohortSpinLock<>);
+LOCK_BENCH(std::mutex);
+
+} // namespace
+} // namespace camus::bench
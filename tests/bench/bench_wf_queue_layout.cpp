@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+#include <common/waitfree/WfQueue.h>
+
+#include <cstdint>
+#include <memory>
+
+// Compares WfQueue policies under pairwise enqueue/dequeue at 8, 32 and 64 threads.
+// Run on the target machine and pick the fastest policy for its core count.
+
+namespace camus::bench {
+namespace {
+
+template <typename Policy>
+std::unique_ptr<WfQueue<int64_t, Policy>> gQueue;
+
+template <typename Policy>
+void setup(const benchmark::State &) {
+    gQueue<Policy> = std::make_unique<WfQueue<int64_t, Policy>>();
+}
+
+template <typename Policy>
+void teardown(const benchmark::State &) {
+    gQueue<Policy>.reset();
+}
+
+template <typename Policy>
+void BM_WfQueuePairs(benchmark::State & state) {
+    typename WfQueue<int64_t, Policy>::Handle h(*gQueue<Policy>);
+    int64_t i = 0;
+    for (auto _ : state) {
+        h.enqueue(++i);
+        benchmark::DoNotOptimize(h.dequeue());
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    auto stats = h.stats();
+    auto ops = static_cast<double>(stats.enqueues + stats.dequeues + stats.emptyDequeues);
+    state.counters["slow_rate"] = benchmark::Counter((stats.slowEnqueues + stats.slowDequeues) / ops, benchmark::Counter::kAvgThreads);
+    state.counters["never_rate"] = benchmark::Counter(stats.neverCells / ops, benchmark::Counter::kAvgThreads);
+}
+
+#define WF_QUEUE_BENCH(...)                              \
+    BENCHMARK_TEMPLATE(BM_WfQueuePairs, __VA_ARGS__)     \
+        ->Setup(setup<__VA_ARGS__>)                      \
+        ->Teardown(teardown<__VA_ARGS__>)                \
+        ->Threads(8)                                     \
+        ->Threads(32)                                    \
+        ->Threads(64)                                    \
+        ->UseRealTime()
+
+// cell layout x segment size
+WF_QUEUE_BENCH(WfQueuePolicy<64, 10, WfCellLayout::PACKED>);
+WF_QUEUE_BENCH(WfQueuePolicy<64, 10, WfCellLayout::PADDED>);
+WF_QUEUE_BENCH(WfQueuePolicy<64, 10, WfCellLayout::SCRAMBLED>);
+WF_QUEUE_BENCH(WfQueuePolicy<1024, 10, WfCellLayout::PACKED>);
+WF_QUEUE_BENCH(WfQueuePolicy<1024, 10, WfCellLayout::PADDED>);
+WF_QUEUE_BENCH(WfQueuePolicy<1024, 10, WfCellLayout::SCRAMBLED>);
+// patience
+WF_QUEUE_BENCH(WfQueuePolicy<1024, 0, WfCellLayout::SCRAMBLED>);
+WF_QUEUE_BENCH(WfQueuePolicy<1024, 100, WfCellLayout::SCRAMBLED>);
+WF_QUEUE_BENCH(WfQueuePolicy<1024, 10, WfCellLayout::SCRAMBLED, true>);
+
+} // namespace
+} // namespace camus::bench
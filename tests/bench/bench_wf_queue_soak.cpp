@@ -0,0 +1,88 @@
+#include <benchmark/benchmark.h>
+#include <common/waitfree/WfQueue.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+// Pushes a lot of items through one queue and checks that memory stays flat, i.e. retired segments
+// are reclaimed. Producers are throttled to keep a bounded backlog, so any growth comes from the queue.
+// Increase the item count for a longer soak.
+
+namespace camus::bench {
+namespace {
+
+int64_t rssKb() {
+    int64_t pages = 0;
+    int64_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+constexpr int64_t MAX_BACKLOG = 1 << 16;
+
+void BM_WfQueueSoak(benchmark::State & state) {
+    const auto pairs = state.range(0);
+    const auto items = state.range(1);
+
+    for (auto _ : state) {
+        WfQueue<int64_t> q;
+        std::atomic<int64_t> produced = 0;
+        std::atomic<int64_t> consumed = 0;
+        // sampled after warm-up, when the queue reaches its steady state
+        std::atomic<int64_t> warmRss = 0;
+        std::atomic<int64_t> maxRss = 0;
+
+        std::vector<std::thread> threads;
+        for (int64_t pair = 0; pair < pairs; ++pair) {
+            threads.emplace_back([&] {
+                WfQueue<int64_t>::Handle h(q);
+                for (int64_t i = 1; i <= items; ++i) {
+                    while (produced.load(std::memory_order_relaxed) - consumed.load(std::memory_order_relaxed) > MAX_BACKLOG)
+                        std::this_thread::yield();
+                    h.enqueue(i);
+                    produced.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+            threads.emplace_back([&] {
+                WfQueue<int64_t>::Handle h(q);
+                for (int64_t i = 0; i < items;) {
+                    if (!h.dequeue()) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    ++i;
+                    auto total = consumed.fetch_add(1) + 1;
+                    if (total % (1 << 20) == 0) {
+                        auto rss = rssKb();
+                        if (total >= pairs * items / 10 && warmRss == 0)
+                            warmRss = rss;
+                        auto prev = maxRss.load();
+                        while (prev < rss && !maxRss.compare_exchange_weak(prev, rss)) {
+                        }
+                    }
+                }
+            });
+        }
+        for (auto & t : threads)
+            t.join();
+
+        state.counters["rss_max_kb"] = static_cast<double>(maxRss);
+        state.counters["rss_growth_kb"] = static_cast<double>(maxRss - std::min(warmRss.load(), maxRss.load()));
+    }
+    state.SetItemsProcessed(pairs * items);
+}
+BENCHMARK(BM_WfQueueSoak)
+    ->ArgNames({"pairs", "items"})
+    ->Args({1, 1 << 26})
+    ->Args({4, 1 << 26})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace camus::bench
@@ -0,0 +1,61 @@
+#include <common/scheduler/ChaseLevDeque.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+TEST(ChaseLevDequeTest, testOwner) {
+    ChaseLevDeque<int64_t> d(2);
+    ASSERT_FALSE(d.pop());
+    for (int64_t i = 0; i < 100; ++i)
+        d.push(i);
+    int64_t v = 0;
+    ASSERT_EQ(d.steal(v), ChaseLevDeque<int64_t>::StealResult::SUCCESS);
+    ASSERT_EQ(v, 0);
+    for (int64_t i = 99; i > 0; --i)
+        ASSERT_EQ(d.pop(), i);
+    ASSERT_FALSE(d.pop());
+    ASSERT_EQ(d.steal(v), ChaseLevDeque<int64_t>::StealResult::EMPTY);
+}
+
+TEST(ChaseLevDequeTest, testSteal) {
+    ChaseLevDeque<int64_t> d(4);
+    static const int64_t thief_count = 4;
+    static const int64_t item_count = 200000;
+    std::vector<std::atomic<int64_t>> seen(item_count);
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> thieves;
+    for (int64_t i = 0; i < thief_count; ++i) {
+        thieves.emplace_back([&] {
+            int64_t v = 0;
+            while (!done.load()) {
+                if (d.steal(v) == ChaseLevDeque<int64_t>::StealResult::SUCCESS)
+                    ++seen[v];
+            }
+        });
+    }
+    for (int64_t i = 0; i < item_count; ++i) {
+        d.push(i);
+        if (i % 3 == 0) {
+            if (auto v = d.pop())
+                ++seen[*v];
+        }
+    }
+    while (auto v = d.pop())
+        ++seen[*v];
+    done = true;
+    for (auto & t : thieves)
+        t.join();
+
+    for (auto & s : seen)
+        ASSERT_EQ(s.load(), 1);
+}
+
+} // namespace
+} // namespace camus::tests
@@ -0,0 +1,165 @@
+#include <common/container/ConcurrentFlatMap.h>
+#include <common/spinlock/adaptive_spinlock.h>
+#include <common/spinlock/nginx_spinlock.h>
+#include <common/spinlock/rw_spinlock.h>
+#include <gtest/gtest.h>
+#include <robin_hood.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+TEST(ConcurrentFlatMapTest, testBasic) {
+    ConcurrentFlatMap<std::string, int> m(4);
+    ASSERT_EQ(m.shardCount(), 4);
+    ASSERT_TRUE(m.insert("a", 1));
+    ASSERT_FALSE(m.insert("a", 2));
+    ASSERT_EQ(m.find("a"), 1);
+    ASSERT_FALSE(m.insertOrAssign("a", 3));
+    ASSERT_TRUE(m.insertOrAssign("b", 4));
+    ASSERT_EQ(m.find(std::string_view("a")), 3);
+    ASSERT_EQ(m.find("c"), std::nullopt);
+    ASSERT_TRUE(m.contains(std::string("b")));
+    ASSERT_EQ(m.size(), 2);
+
+    ASSERT_TRUE(m.erase(std::string_view("a")));
+    ASSERT_FALSE(m.erase("a"));
+    ASSERT_EQ(m.size(), 1);
+    m.clear();
+    ASSERT_EQ(m.size(), 0);
+    ASSERT_FALSE(m.contains("b"));
+}
+
+// robin_hood only takes other key types than K when both Hash and KeyEqual are transparent. Otherwise a const
+// char * would still compile, through a temporary std::string.
+static_assert(robin_hood::unordered_flat_map<std::string, int, detail::flat_map::Hash<std::string>, std::equal_to<>>::
+                  is_transparent);
+static_assert(!robin_hood::unordered_flat_map<int64_t, int, detail::flat_map::Hash<int64_t>, std::equal_to<>>::
+                  is_transparent);
+
+TEST(ConcurrentFlatMapTest, testHeterogeneous) {
+    ConcurrentFlatMap<std::string, int> m(4);
+    std::string_view text = "alpha beta";
+    // slices that are not null-terminated
+    auto alpha = text.substr(0, 5);
+    auto beta = text.substr(6);
+    ASSERT_TRUE(m.upsert(alpha, [](int & v) { v = 1; }));
+    ASSERT_TRUE(m.insert(std::string(beta), 2));
+    ASSERT_EQ(m.find("alpha"), 1);
+    ASSERT_EQ(m.find(beta), 2);
+    ASSERT_FALSE(m.contains(text.substr(0, 4)));
+    ASSERT_FALSE(m.contains(text));
+
+    const char * cstr = "beta";
+    ASSERT_TRUE(m.contains(cstr));
+    ASSERT_FALSE(m.upsert(cstr, [](int & v) { v += 10; }));
+    ASSERT_EQ(m.find(std::string("beta")), 12);
+
+    // embedded NUL: a length is used, not strlen
+    std::string nul("a\0b", 3);
+    ASSERT_TRUE(m.insert(nul, 3));
+    ASSERT_EQ(m.find(std::string_view(nul)), 3);
+    ASSERT_FALSE(m.contains("a"));
+
+    ASSERT_TRUE(m.erase(alpha));
+    ASSERT_TRUE(m.erase(cstr));
+    ASSERT_TRUE(m.erase(std::string_view(nul)));
+    ASSERT_FALSE(m.erase(beta));
+    ASSERT_EQ(m.size(), 0);
+    ASSERT_EQ(m.stats().erases, 3);
+}
+
+TEST(ConcurrentFlatMapTest, testVisitUpsert) {
+    ConcurrentFlatMap<std::string, std::vector<int>> m;
+    ASSERT_TRUE(m.upsert(std::string_view("k"), [](std::vector<int> & v) { v.push_back(1); }));
+    ASSERT_FALSE(m.upsert("k", [](std::vector<int> & v) { v.push_back(2); }));
+    size_t seen = 0;
+    ASSERT_TRUE(m.visit("k", [&](const std::vector<int> & v) { seen = v.size(); }));
+    ASSERT_EQ(seen, 2);
+    ASSERT_FALSE(m.visit("x", [&](const std::vector<int> &) { FAIL(); }));
+
+    int64_t sum = 0;
+    m.insert("j", {10});
+    m.forEach([&](const std::string &, const std::vector<int> & v) {
+        for (auto x : v)
+            sum += x;
+    });
+    ASSERT_EQ(sum, 13);
+}
+
+TEST(ConcurrentFlatMapTest, testStats) {
+    ConcurrentFlatMap<int64_t, int64_t> m(8);
+    for (int64_t i = 0; i < 100; ++i)
+        m.insert(i, i);
+    for (int64_t i = 0; i < 10; ++i)
+        m.upsert(i, [](int64_t & v) { ++v; });
+    for (int64_t i = 0; i < 20; ++i)
+        m.erase(i);
+    auto stats = m.stats();
+    ASSERT_EQ(stats.size, 80);
+    ASSERT_EQ(stats.inserts, 100);
+    ASSERT_EQ(stats.updates, 10);
+    ASSERT_EQ(stats.erases, 20);
+
+    // keys are spread over shards
+    int64_t nonEmpty = 0;
+    for (size_t i = 0; i < m.shardCount(); ++i)
+        nonEmpty += m.shardStats(i).size > 0;
+    ASSERT_EQ(nonEmpty, 8);
+}
+
+template <typename Lock>
+class ConcurrentFlatMapLockTest : public ::testing::Test {};
+
+using MapLockTypes = ::testing::Types<RwSpinLock, BrSpinLock, AdaptiveSpinLock, NginxSpinLock>;
+TYPED_TEST_SUITE(ConcurrentFlatMapLockTest, MapLockTypes);
+
+TYPED_TEST(ConcurrentFlatMapLockTest, testConcurrent) {
+    constexpr int64_t KEYS = 1000;
+    constexpr int64_t ROUNDS = 20;
+    const int64_t threads = std::max<int64_t>(std::thread::hardware_concurrency(), 2);
+    ConcurrentFlatMap<int64_t, int64_t, TypeParam> m(16);
+    std::atomic<bool> stop = false;
+
+    // polls stats while writers run
+    std::thread poller([&] {
+        while (!stop.load()) {
+            auto stats = m.stats();
+            ASSERT_LE(stats.size, KEYS);
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (int64_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (int64_t r = 0; r < ROUNDS; ++r) {
+                for (int64_t k = 0; k < KEYS; ++k) {
+                    m.upsert(k, [](int64_t & v) { ++v; });
+                    m.visit(k, [](const int64_t & v) { ASSERT_GT(v, 0); });
+                }
+            }
+        });
+    }
+    for (auto & w : workers)
+        w.join();
+    stop = true;
+    poller.join();
+
+    ASSERT_EQ(m.size(), KEYS);
+    for (int64_t k = 0; k < KEYS; ++k)
+        ASSERT_EQ(m.find(k), threads * ROUNDS);
+    auto stats = m.stats();
+    ASSERT_EQ(stats.inserts, KEYS);
+    ASSERT_EQ(stats.updates, threads * ROUNDS * KEYS - KEYS);
+}
+
+} // namespace
+} // namespace camus::tests
@@ -0,0 +1,109 @@
+#include <common/utils/Numa.h>
+#include <common/waitfree/NumaWfQueue.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+TEST(NumaTest, testTopology) {
+    auto nodes = numaNodeCount();
+    ASSERT_GE(nodes, 1);
+    auto ids = numaNodeIds();
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+    ASSERT_EQ(ids.back() + 1, nodes);
+    for (auto id : ids) {
+        for (auto cpu : numaNodeCpus(id))
+            ASSERT_EQ(numaCpuNodes()[cpu], id);
+    }
+    ASSERT_GE(currentNumaNode(), 0);
+    ASSERT_TRUE(numaNodeCpus(nodes + 1000).empty());
+}
+
+TEST(NumaWfQueueTest, testLocalFirst) {
+    NumaWfQueue<int64_t> q(2);
+    NumaWfQueue<int64_t>::Handle h0(q, 0);
+    NumaWfQueue<int64_t>::Handle h1(q, 1);
+    ASSERT_EQ(q.nodeCount(), 2);
+    ASSERT_FALSE(h0.dequeue());
+    h0.enqueue(1);
+    h1.enqueue(2);
+    // the local shard first, then the other one
+    ASSERT_EQ(h0.dequeue(), 1);
+    ASSERT_EQ(h0.dequeue(), 2);
+    ASSERT_FALSE(h0.dequeue());
+    ASSERT_FALSE(h1.dequeue());
+}
+
+TEST(NumaWfQueueTest, testNoStealFromEmpty) {
+    NumaWfQueue<int64_t> q(3);
+    NumaWfQueue<int64_t>::Handle h0(q, 0);
+    NumaWfQueue<int64_t>::Handle h2(q, 2);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_FALSE(h0.dequeue());
+    // only the local shard was dequeued from, remote ones were polled
+    ASSERT_EQ(h0.stats().emptyDequeues, 100);
+    h2.enqueue(1);
+    ASSERT_EQ(h0.dequeue(), 1);
+    auto stats = q.stats();
+    ASSERT_EQ(stats.emptyDequeues, 101);
+    ASSERT_EQ(stats.dequeues, 1);
+    // a cell of the local shard per miss, none of remote ones
+    ASSERT_EQ(stats.neverCells, 101);
+}
+
+TEST(NumaWfQueueTest, testFifoPerHandle) {
+    NumaWfQueue<int64_t> q(3);
+    NumaWfQueue<int64_t>::Handle producer(q, 1);
+    NumaWfQueue<int64_t>::Handle consumer(q, 2);
+    for (int64_t i = 0; i < 1000; ++i)
+        producer.enqueue(i);
+    for (int64_t i = 0; i < 1000; ++i)
+        ASSERT_EQ(consumer.dequeue(), i);
+    ASSERT_FALSE(consumer.dequeue());
+    ASSERT_EQ(q.stats().enqueues, 1000);
+    ASSERT_EQ(q.stats().dequeues, 1000);
+}
+
+TEST(NumaWfQueueTest, testConcurrent) {
+    NumaWfQueue<int64_t> q(4);
+    static const int64_t pair_count = 4;
+    static const int64_t item_count = 20000;
+    std::atomic<int64_t> consumed = 0;
+    std::atomic<int64_t> sum = 0;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < pair_count; ++i) {
+        threads.emplace_back([&, i] {
+            NumaWfQueue<int64_t>::Handle h(q, static_cast<int>(i));
+            for (int64_t j = 1; j <= item_count; ++j)
+                h.enqueue(j);
+        });
+        // consumers of one node, so that the others are only stolen from
+        threads.emplace_back([&] {
+            NumaWfQueue<int64_t>::Handle h(q, 0);
+            while (consumed.load() < pair_count * item_count) {
+                if (auto v = h.dequeue()) {
+                    sum += *v;
+                    ++consumed;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(consumed, pair_count * item_count);
+    ASSERT_EQ(sum, pair_count * item_count * (item_count + 1) / 2);
+}
+
+} // namespace
+} // namespace camus::tests
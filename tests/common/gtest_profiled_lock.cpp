@@ -0,0 +1,80 @@
+#include <common/spinlock/lock_profiling.h>
+#include <common/spinlock/nginx_spinlock.h>
+#include <common/spinlock/profiled_lock.h>
+#include <common/spinlock/rw_spinlock.h>
+#include <common/spinlock/ticket_spinlock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+TEST(ProfiledLockTest, testLock) {
+    ProfiledLock<TicketSpinLock> lk("test_lock");
+    static const int64_t thread_count = std::max<int64_t>(std::thread::hardware_concurrency(), 2);
+    int64_t value = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&] {
+            for (int j = 0; j < 10000; ++j) {
+                lk.lock();
+                value += 1;
+                lk.unlock();
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(value, thread_count * 10000);
+#ifdef CAMUS_LOCK_PROFILING
+    auto profiles = collectLockProfiles();
+    auto it = std::find_if(profiles.begin(), profiles.end(), [](auto & p) { return p.name == "test_lock"; });
+    ASSERT_NE(it, profiles.end());
+    // all threads exited, so their histograms are merged
+    ASSERT_EQ(it->waitNs.count, thread_count * 10000);
+    ASSERT_EQ(it->holdNs.count, thread_count * 10000);
+    ASSERT_NE(dumpLockProfiles().find("test_lock: count="), std::string::npos);
+#else
+    static_assert(sizeof(ProfiledLock<TicketSpinLock>) == sizeof(TicketSpinLock));
+#endif
+}
+
+TEST(ProfiledLockTest, testShared) {
+    ProfiledLock<RwSpinLock> lk("test_shared");
+    lk.lock_shared();
+    lk.lock_shared();
+    lk.unlock_shared();
+    lk.unlock_shared();
+    lk.lock();
+    lk.unlock();
+#ifdef CAMUS_LOCK_PROFILING
+    auto profiles = collectLockProfiles();
+    auto it = std::find_if(profiles.begin(), profiles.end(), [](auto & p) { return p.name == "test_shared"; });
+    ASSERT_NE(it, profiles.end());
+    ASSERT_EQ(it->waitNs.count, 3);
+    ASSERT_EQ(it->holdNs.count, 1);
+#endif
+}
+
+TEST(LockHistogramTest, testPercentile) {
+    LockHistogram h;
+    ASSERT_EQ(h.percentile(0.5), 0);
+    h.buckets[0] = 50;
+    h.buckets[4] = 49; // [8, 16)
+    h.buckets[11] = 1; // [1024, 2048)
+    h.count = 100;
+    h.max = 1500;
+    ASSERT_EQ(h.percentile(0.25), 0);
+    ASSERT_EQ(h.percentile(0.6), 15);
+    ASSERT_EQ(h.percentile(1), 1500);
+}
+
+} // namespace
+} // namespace camus::tests
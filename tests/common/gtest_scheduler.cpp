@@ -0,0 +1,94 @@
+#include <common/scheduler/AsioExecutor.h>
+#include <common/scheduler/Scheduler.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+TEST(SchedulerTest, testPost) {
+    static const int64_t task_count = 10000;
+    Scheduler s(4);
+    std::atomic<int64_t> sum = 0;
+    std::latch done(task_count);
+    for (int64_t i = 1; i <= task_count; ++i) {
+        s.post([&, i] {
+            sum += i;
+            done.count_down();
+        });
+    }
+    done.wait();
+    ASSERT_EQ(sum, task_count * (task_count + 1) / 2);
+}
+
+TEST(SchedulerTest, testNestedPost) {
+    Scheduler s(4);
+    std::atomic<int64_t> leaves = 0;
+    std::latch done(1 << 14);
+    // a binary tree of tasks, spawned by workers and balanced by stealing.
+    std::function<void(int)> spawn = [&](int depth) {
+        if (depth == 0) {
+            ++leaves;
+            done.count_down();
+            return;
+        }
+        s.post([&, depth] { spawn(depth - 1); });
+        s.post([&, depth] { spawn(depth - 1); });
+    };
+    s.post([&] { spawn(14); });
+    done.wait();
+    ASSERT_EQ(leaves, 1 << 14);
+}
+
+TEST(SchedulerTest, testStopRunsPosted) {
+    std::atomic<int64_t> count = 0;
+    {
+        Scheduler s(2);
+        for (int i = 0; i < 1000; ++i) {
+            s.post([&, p = std::make_unique<int>(i)] {
+                ++count;
+                std::this_thread::yield();
+            });
+        }
+        s.stop();
+        ASSERT_EQ(count, 1000);
+    }
+    // a thread posting to different schedulers
+    for (int i = 0; i < 10; ++i) {
+        Scheduler s(1);
+        s.post([&] { ++count; });
+    }
+    ASSERT_EQ(count, 1010);
+}
+
+TEST(SchedulerTest, testAsio) {
+    Scheduler s(2);
+    AsioSchedulerContext ctx(s);
+    std::latch done(2);
+    boost::asio::post(ctx.get_executor(), [&] { done.count_down(); });
+    boost::asio::co_spawn(
+        ctx.get_executor(),
+        [&]() -> boost::asio::awaitable<void> {
+            // resumes on the scheduler
+            co_await boost::asio::post(ctx.get_executor(), boost::asio::use_awaitable);
+            EXPECT_TRUE(s.inWorker());
+            done.count_down();
+        },
+        boost::asio::detached);
+    done.wait();
+}
+
+} // namespace
+} // namespace camus::tests
@@ -0,0 +1,184 @@
+#include <common/waitfree/Snapshot.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+TEST(SnapshotTest, testReadUpdate) {
+    Snapshot<std::string> s("a");
+    ASSERT_EQ(*s.read(), "a");
+    s.update([](const std::string & v) { return v + "b"; });
+    ASSERT_EQ(*s.read(), "ab");
+    s.publish("c");
+    ASSERT_EQ(s.read()->size(), 1);
+    ASSERT_EQ(s.read().get(), "c");
+}
+
+TEST(SnapshotTest, testGuardKeepsVersion) {
+    auto p = std::make_shared<int>(1);
+    {
+        Snapshot<std::shared_ptr<int>> s(p);
+        auto guard = s.read();
+        s.publish(std::make_shared<int>(2));
+        s.publish(std::make_shared<int>(3));
+        // the first version is still held by the guard
+        ASSERT_EQ(p.use_count(), 2);
+        ASSERT_EQ(**guard, 1);
+        auto moved = std::move(guard);
+        ASSERT_EQ(**moved, 1);
+        moved = s.read();
+        ASSERT_EQ(p.use_count(), 1);
+        ASSERT_EQ(**moved, 3);
+    }
+    ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST(SnapshotTest, testUpdateThrows) {
+    Snapshot<int> s(1);
+    ASSERT_THROW(s.update([](int) -> int { throw std::runtime_error("no"); }), std::runtime_error);
+    ASSERT_EQ(*s.read(), 1);
+    s.update([](int v) { return v + 1; });
+    ASSERT_EQ(*s.read(), 2);
+}
+
+TEST(SnapshotTest, testTryPublish) {
+    Snapshot<int, 2> s(1);
+    auto guard = s.read();
+    ASSERT_TRUE(s.tryPublish(2));
+    // both slots are taken by the held version and the current one
+    ASSERT_FALSE(s.tryPublish(3));
+    ASSERT_EQ(*s.read(), 2);
+    guard = s.read();
+    ASSERT_TRUE(s.tryPublish(3));
+    ASSERT_EQ(*guard, 2);
+    ASSERT_EQ(*s.read(), 3);
+}
+
+TEST(SnapshotTest, testPublishWaitsForSlot) {
+    Snapshot<int, 2> s(1);
+    std::optional<Snapshot<int, 2>::ReadGuard> guard = s.read();
+    s.publish(2);
+    std::atomic<bool> published = false;
+    std::thread writer([&] {
+        s.publish(3);
+        published = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(published);
+    guard.reset();
+    writer.join();
+    ASSERT_EQ(*s.read(), 3);
+}
+
+TEST(SnapshotTest, testReclaimer) {
+    auto p = std::make_shared<int>(1);
+    Reclaimer reclaimer;
+    {
+        Snapshot<std::shared_ptr<int>> s(p, &reclaimer);
+        auto guard = s.read();
+        s.publish(std::make_shared<int>(2));
+        guard = s.read();
+        // released by the guard, but not destroyed
+        ASSERT_EQ(p.use_count(), 2);
+        ASSERT_EQ(reclaimer.reclaim(), 1);
+        ASSERT_EQ(p.use_count(), 1);
+        s.publish(p);
+    }
+    ASSERT_EQ(p.use_count(), 2);
+    ASSERT_EQ(reclaimer.reclaim(), 2);
+    ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST(SnapshotTest, testReclaimerThread) {
+    auto p = std::make_shared<int>(1);
+    {
+        Reclaimer reclaimer(std::chrono::milliseconds(1));
+        Snapshot<std::shared_ptr<int>> s(p, &reclaimer);
+        s.publish(nullptr);
+        while (p.use_count() != 1)
+            std::this_thread::yield();
+        s.publish(p);
+    }
+    ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST(SnapshotTest, testPerCpuReads) {
+    auto p = std::make_shared<int>(1);
+    {
+        Snapshot<std::shared_ptr<int>, 2, true> s(p);
+        std::optional<Snapshot<std::shared_ptr<int>, 2, true>::ReadGuard> guard = s.read();
+        std::thread([&] { ASSERT_EQ(**s.read(), 1); }).join();
+        s.publish(nullptr);
+        ASSERT_FALSE(s.tryPublish(nullptr));
+        ASSERT_EQ(p.use_count(), 2);
+        guard.reset();
+        ASSERT_EQ(p.use_count(), 1);
+        ASSERT_TRUE(s.tryPublish(p));
+        std::thread([&] { ASSERT_EQ(*s.read(), p); }).join();
+    }
+    ASSERT_EQ(p.use_count(), 1);
+}
+
+// PerCpuReads
+template <typename PerCpuReads>
+class SnapshotModeTest : public ::testing::Test {};
+
+using SnapshotModes = ::testing::Types<std::false_type, std::true_type>;
+TYPED_TEST_SUITE(SnapshotModeTest, SnapshotModes);
+
+TYPED_TEST(SnapshotModeTest, testConcurrent) {
+    // both halves are always equal in a version
+    struct Pair {
+        int64_t a = 0;
+        int64_t b = 0;
+    };
+    Snapshot<Pair, 4, TypeParam::value> s;
+    static const int64_t reader_count = 4;
+    static const int64_t writer_count = 2;
+    static const int64_t update_count = 20000;
+    std::atomic<int64_t> writers_done = 0;
+    std::atomic<bool> torn = false;
+    // newest version any reader has seen, no read after it may return an older one.
+    std::atomic<int64_t> seen = 0;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < reader_count; ++i) {
+        threads.emplace_back([&] {
+            while (writers_done.load() < writer_count) {
+                auto floor = seen.load();
+                auto r = s.read();
+                if (r->a != r->b || r->a < floor)
+                    torn = true;
+                for (auto v = floor; v < r->a && !seen.compare_exchange_weak(v, r->a);) {
+                }
+            }
+        });
+    }
+    for (int64_t i = 0; i < writer_count; ++i) {
+        threads.emplace_back([&] {
+            for (int64_t j = 0; j < update_count; ++j)
+                s.update([](const Pair & p) { return Pair{p.a + 1, p.b + 1}; });
+            ++writers_done;
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_FALSE(torn);
+    ASSERT_EQ(s.read()->a, writer_count * update_count);
+}
+
+} // namespace
+} // namespace camus::tests
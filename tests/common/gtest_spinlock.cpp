@@ -1,9 +1,18 @@
+#include <common/spinlock/adaptive_spinlock.h>
+#include <common/spinlock/clh_spinlock.h>
+#include <common/spinlock/cohort_spinlock.h>
+#include <common/spinlock/mcs_spinlock.h>
 #include <common/spinlock/nginx_spinlock.h>
+#include <common/spinlock/rw_spinlock.h>
 #include <common/spinlock/ticket_spinlock.h>
 #include <common/spinlock/trivial_exchange_spinlock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <ctime>
 #include <thread>
 #include <vector>
 
@@ -17,7 +26,14 @@ class SpinLockTest : public ::testing::Test {
 using SpinLockTypes = ::testing::Types<
     NginxSpinLock,
     TrivialSpinLock,
-    TicketSpinLock>;
+    TicketSpinLock,
+    McsSpinLock,
+    ClhSpinLock,
+    AdaptiveSpinLock,
+    RwSpinLock,
+    BrSpinLock,
+    CohortSpinLock<>,
+    CohortSpinLock<NginxSpinLock, TicketSpinLock>>;
 TYPED_TEST_SUITE(SpinLockTest, SpinLockTypes);
 
 TYPED_TEST(SpinLockTest, testLock) {
@@ -43,5 +59,186 @@ TYPED_TEST(SpinLockTest, testLock) {
     ASSERT_EQ(value, thread_count * 1000000);
 }
 
+TYPED_TEST(SpinLockTest, testInterleaved) {
+    TypeParam a;
+    TypeParam b;
+    static const int64_t thread_count = std::thread::hardware_concurrency();
+    int64_t value_a = 0;
+    int64_t value_b = 0;
+
+    // locks are not released in reverse order
+    auto f = [&] {
+        for (int i = 0; i < 100000; ++i) {
+            a.lock();
+            value_a += 1;
+            b.lock();
+            a.unlock();
+            value_b += 1;
+            b.unlock();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i)
+        threads.emplace_back(f);
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(value_a, thread_count * 100000);
+    ASSERT_EQ(value_b, thread_count * 100000);
+}
+
+template <typename T>
+class RwSpinLockTest : public ::testing::Test {
+};
+
+using RwSpinLockTypes = ::testing::Types<
+    RwSpinLock,
+    BrSpinLock>;
+TYPED_TEST_SUITE(RwSpinLockTest, RwSpinLockTypes);
+
+TYPED_TEST(RwSpinLockTest, testSharedTogether) {
+    TypeParam lk;
+    lk.lock_shared();
+    // another reader gets in while this one holds it
+    std::thread([&] {
+        lk.lock_shared();
+        lk.unlock_shared();
+    }).join();
+    lk.unlock_shared();
+    lk.lock();
+    lk.unlock();
+}
+
+TYPED_TEST(RwSpinLockTest, testWriterPreference) {
+    TypeParam lk;
+    lk.lock_shared();
+    std::atomic<bool> written = false;
+    std::thread writer([&] {
+        lk.lock();
+        written = true;
+        lk.unlock();
+    });
+    // wait for the writer to be waiting, then new readers must not get in
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::atomic<bool> read = false;
+    std::thread reader([&] {
+        lk.lock_shared();
+        read = true;
+        ASSERT_TRUE(written);
+        lk.unlock_shared();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(read);
+    ASSERT_FALSE(written);
+    lk.unlock_shared();
+    writer.join();
+    reader.join();
+    ASSERT_TRUE(read);
+}
+
+TYPED_TEST(RwSpinLockTest, testReadWrite) {
+    TypeParam lk;
+    static const int64_t thread_count = std::max<int64_t>(std::thread::hardware_concurrency(), 2);
+    // only changed together under the exclusive lock
+    int64_t a = 0;
+    int64_t b = 0;
+    std::atomic<bool> torn = false;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < 100000; ++j) {
+                if ((i + j) % 8 == 0) {
+                    lk.lock();
+                    ++a;
+                    ++b;
+                    lk.unlock();
+                } else {
+                    lk.lock_shared();
+                    if (a != b)
+                        torn = true;
+                    lk.unlock_shared();
+                }
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_FALSE(torn);
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(a, thread_count * 100000 / 8);
+}
+
+TEST(AdaptiveSpinLockTest, testParks) {
+    AdaptiveSpinLock lk;
+    lk.lock();
+    std::atomic<bool> waiting = false;
+    std::chrono::nanoseconds waiter_cpu{0};
+    std::thread waiter([&] {
+        auto cpu = [] {
+            timespec ts{};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+        };
+        auto start = cpu();
+        waiting = true;
+        lk.lock();
+        waiter_cpu = cpu() - start;
+        lk.unlock();
+    });
+    while (!waiting)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    lk.unlock();
+    waiter.join();
+    // spun for microseconds, then parked
+    ASSERT_LT(waiter_cpu, std::chrono::milliseconds(50));
+}
+
+// logical node of the calling thread, for CohortSpinLock
+thread_local int t_node = 0;
+
+struct ThreadNode {
+    int operator()() const { return t_node; }
+};
+
+// Node 0 holds the lock while C of node 0 and then B of node 1 wait. C gets it within the cohort while the
+// batch allows, otherwise B, which queued first for the global lock.
+std::vector<char> cohortOrder(int64_t maxBatch) {
+    CohortSpinLock<TicketSpinLock, McsSpinLock, ThreadNode> lk(maxBatch, 2);
+    std::vector<char> order;
+    std::atomic<int> inside = 0;
+    auto waiter = [&](char name, int node) {
+        return std::thread([&, name, node] {
+            t_node = node;
+            lk.lock();
+            EXPECT_EQ(inside.fetch_add(1), 0);
+            order.push_back(name);
+            inside.fetch_sub(1);
+            lk.unlock();
+        });
+    };
+    t_node = 0;
+    lk.lock();
+    auto c = waiter('C', 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto b = waiter('B', 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    order.push_back('A');
+    lk.unlock();
+    c.join();
+    b.join();
+    return order;
+}
+
+TEST(CohortSpinLockTest, testHandoff) {
+    ASSERT_EQ(cohortOrder(64), (std::vector<char>{'A', 'C', 'B'}));
+    ASSERT_EQ(cohortOrder(1), (std::vector<char>{'A', 'B', 'C'}));
+}
+
 } // namespace
 } // namespace camus::tests
@@ -0,0 +1,752 @@
+#include <common/waitfree/WfQueue.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace camus::tests {
+namespace {
+
+std::chrono::nanoseconds threadCpuTime() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+TEST(WfQueueTest, testFifo) {
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    ASSERT_FALSE(h.dequeue());
+    for (int64_t i = 0; i < 1000; ++i)
+        h.enqueue(i);
+    for (int64_t i = 0; i < 1000; ++i)
+        ASSERT_EQ(h.dequeue(), i);
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testMoveOnly) {
+    WfQueue<std::unique_ptr<std::string>> q;
+    WfQueue<std::unique_ptr<std::string>>::Handle h(q);
+    h.enqueue(std::make_unique<std::string>("hello"));
+    auto v = h.dequeue();
+    ASSERT_TRUE(v);
+    ASSERT_EQ(**v, "hello");
+}
+
+TEST(WfQueueTest, testDestroyLeftValues) {
+    auto p = std::make_shared<int>(0);
+    {
+        WfQueue<std::shared_ptr<int>> q;
+        WfQueue<std::shared_ptr<int>>::Handle h(q);
+        for (int i = 0; i < 1000; ++i)
+            h.enqueue(p);
+        ASSERT_EQ(p.use_count(), 1001);
+    }
+    ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST(WfQueueTest, testReuseHandle) {
+    WfQueue<int64_t> q;
+    for (int64_t i = 0; i < 100; ++i) {
+        std::thread([&] {
+            WfQueue<int64_t>::Handle h(q);
+            h.enqueue(i);
+        }).join();
+    }
+    WfQueue<int64_t>::Handle h(q);
+    for (int64_t i = 0; i < 100; ++i)
+        ASSERT_EQ(h.dequeue(), i);
+}
+
+TEST(WfQueueTest, testJoinLeave) {
+    WfQueue<int64_t> q;
+    static const int64_t pair_count = 4;
+    static const int64_t round_count = 2000;
+    static const int64_t batch_size = 50;
+    std::atomic<int64_t> consumed = 0;
+    std::atomic<int64_t> sum = 0;
+
+    // handles come and go while others are working
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < pair_count; ++i) {
+        threads.emplace_back([&] {
+            for (int64_t r = 0; r < round_count; ++r) {
+                WfQueue<int64_t>::Handle h(q);
+                for (int64_t j = 1; j <= batch_size; ++j)
+                    h.enqueue(j);
+            }
+        });
+        threads.emplace_back([&] {
+            while (consumed.load() < pair_count * round_count * batch_size) {
+                WfQueue<int64_t>::Handle h(q);
+                for (int64_t j = 0; j < batch_size; ++j) {
+                    if (auto v = h.dequeue()) {
+                        sum += *v;
+                        ++consumed;
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(consumed, pair_count * round_count * batch_size);
+    ASSERT_EQ(sum, pair_count * round_count * batch_size * (batch_size + 1) / 2);
+    ASSERT_EQ(q.stats().enqueues, pair_count * round_count * batch_size);
+}
+
+constexpr int64_t SEGMENT_SIZE = WfQueuePolicy<>::SEGMENT_SIZE;
+
+int64_t liveSegments(const WfQueueStats & s) {
+    return s.segmentAllocs - s.segmentFrees;
+}
+
+TEST(WfQueueTest, testReclaimSegments) {
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    for (int64_t round = 0; round < 10; ++round) {
+        for (int64_t i = 0; i < 16 * SEGMENT_SIZE; ++i)
+            h.enqueue(i);
+        for (int64_t i = 0; i < 16 * SEGMENT_SIZE; ++i)
+            ASSERT_EQ(h.dequeue(), i);
+    }
+    // 160 segments were passed, all but a few came back
+    auto s = q.stats();
+    ASSERT_GE(s.segmentFrees + s.segmentReuses, 150);
+    ASSERT_LE(liveSegments(s), 24);
+}
+
+TEST(WfQueueTest, testIdleHandleHoldsNoSegments) {
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle idle(q);
+    {
+        WfQueue<int64_t>::Handle h(q);
+        for (int64_t i = 0; i < 64 * SEGMENT_SIZE; ++i) {
+            h.enqueue(i);
+            h.dequeue();
+        }
+    }
+    // cleanup moved the segment pointers of the idle handle along
+    auto s = q.stats();
+    ASSERT_GE(s.segmentFrees + s.segmentReuses, 56);
+    ASSERT_LE(liveSegments(s), 24);
+    idle.enqueue(1);
+    ASSERT_EQ(idle.dequeue(), 1);
+}
+
+// Once armed, the next move waits until released, so that a dequeuer taking the value out of its cell is
+// caught inside an operation.
+struct Pausing {
+    static inline std::atomic<bool> armed = false;
+    static inline std::atomic<bool> paused = false;
+    static inline std::atomic<bool> released = false;
+
+    explicit Pausing(int64_t v_ = 0)
+        : v(v_) {}
+
+    Pausing(Pausing && other) noexcept
+        : v(other.v) {
+        if (armed.exchange(false)) {
+            paused = true;
+            paused.notify_all();
+            released.wait(false);
+        }
+    }
+
+    Pausing & operator=(Pausing && other) noexcept {
+        v = other.v;
+        return *this;
+    }
+
+    int64_t v;
+};
+
+TEST(WfQueueTest, testHazardBlocksReclaim) {
+    WfQueue<Pausing> q;
+    WfQueue<Pausing>::Handle h(q);
+    h.enqueue(Pausing(-1));
+    Pausing::armed = true;
+    std::thread paused([&] {
+        WfQueue<Pausing>::Handle p(q);
+        p.dequeue();
+    });
+    Pausing::paused.wait(false);
+
+    auto run = [&] {
+        for (int64_t i = 0; i < 64 * SEGMENT_SIZE; ++i) {
+            h.enqueue(Pausing(i));
+            h.dequeue();
+        }
+    };
+    // the hazard of the paused dequeuer keeps every segment since the first one
+    run();
+    auto s = q.stats();
+    ASSERT_EQ(s.segmentFrees + s.segmentReuses, 0);
+    ASSERT_GE(liveSegments(s), 64);
+
+    Pausing::released = true;
+    Pausing::released.notify_all();
+    paused.join();
+    run();
+    s = q.stats();
+    ASSERT_GE(s.segmentFrees + s.segmentReuses, 120);
+    ASSERT_LE(liveSegments(s), 24);
+}
+
+TEST(WfQueueTest, testSteadyStateStopsAllocating) {
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    auto run = [&] {
+        for (int64_t i = 0; i < 16 * SEGMENT_SIZE; ++i) {
+            h.enqueue(i);
+            ASSERT_EQ(h.dequeue(), i);
+        }
+    };
+    run();
+    auto allocs = q.stats().segmentAllocs;
+    for (int64_t round = 0; round < 4; ++round)
+        run();
+    // segments are taken from spares refilled by cleanup
+    auto s = q.stats();
+    ASSERT_EQ(s.segmentAllocs, allocs);
+    ASSERT_GE(s.segmentReuses, 64);
+}
+
+TEST(WfQueueTest, testSpareOfLeftHandleReused) {
+    WfQueue<int64_t> q;
+    {
+        WfQueue<int64_t>::Handle a(q);
+        WfQueue<int64_t>::Handle b(q);
+    }
+    auto allocs = q.stats().segmentAllocs;
+    // records are taken over along with their spares
+    for (int64_t i = 0; i < 100; ++i) {
+        WfQueue<int64_t>::Handle a(q);
+        WfQueue<int64_t>::Handle b(q);
+    }
+    ASSERT_EQ(q.stats().segmentAllocs, allocs);
+
+    std::thread([&] {
+        WfQueue<int64_t>::Handle c(q);
+        // the second segment is the spare left in the record, only the refill is allocated
+        for (int64_t i = 0; i <= SEGMENT_SIZE; ++i)
+            c.enqueue(i);
+    }).join();
+    ASSERT_EQ(q.stats().segmentAllocs, allocs + 1);
+}
+
+TEST(WfQueueTest, testBulk) {
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    std::vector<int64_t> in(1000);
+    for (int64_t i = 0; i < 1000; ++i)
+        in[i] = i;
+    h.enqueueBulk(std::span(in).first(500));
+    for (int64_t i = 500; i < 1000; ++i)
+        h.enqueue(i);
+
+    std::vector<int64_t> out;
+    while (out.size() < 1000)
+        ASSERT_NE(h.dequeueBulk(std::back_inserter(out), 64), 0);
+    ASSERT_EQ(out, in);
+    ASSERT_EQ(h.dequeueBulk(std::back_inserter(out), 64), 0);
+}
+
+TEST(WfQueueTest, testEmptyBulkBurnsNoCells) {
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    std::vector<int64_t> out;
+    for (int64_t i = 0; i < 100; ++i)
+        ASSERT_EQ(h.dequeueBulk(std::back_inserter(out), 1024), 0);
+    h.enqueue(1);
+    h.enqueue(2);
+    // capped by the 2 values in the queue, then nothing to reserve.
+    ASSERT_EQ(h.dequeueBulk(std::back_inserter(out), 1024), 2);
+    ASSERT_EQ(h.dequeueBulk(std::back_inserter(out), 1024), 0);
+    h.enqueue(3);
+    ASSERT_EQ(h.dequeue(), 3);
+    auto s = h.stats();
+    ASSERT_EQ(s.neverCells, 0);
+    ASSERT_EQ(s.slowEnqueues, 0);
+    ASSERT_EQ(s.emptyDequeues, 101);
+}
+
+TEST(WfQueueTest, testConcurrent) {
+    WfQueue<int64_t> q;
+    static const int64_t pair_count = std::max<int64_t>(std::thread::hardware_concurrency() / 2, 2);
+    static const int64_t item_count = 100000;
+    std::atomic<int64_t> consumed = 0;
+    std::atomic<int64_t> sum = 0;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < pair_count; ++i) {
+        threads.emplace_back([&] {
+            WfQueue<int64_t>::Handle h(q);
+            for (int64_t j = 1; j <= item_count; ++j)
+                h.enqueue(j);
+        });
+        threads.emplace_back([&] {
+            WfQueue<int64_t>::Handle h(q);
+            while (consumed.load() < pair_count * item_count) {
+                if (auto v = h.dequeue()) {
+                    sum += *v;
+                    ++consumed;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(consumed, pair_count * item_count);
+    ASSERT_EQ(sum, pair_count * item_count * (item_count + 1) / 2);
+}
+
+TEST(WfQueueTest, testConcurrentBulk) {
+    WfQueue<int64_t> q;
+    static const int64_t pair_count = std::max<int64_t>(std::thread::hardware_concurrency() / 2, 2);
+    static const int64_t batch_count = 10000;
+    static const int64_t batch_size = 16;
+    std::atomic<int64_t> consumed = 0;
+    std::atomic<int64_t> sum = 0;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < pair_count; ++i) {
+        threads.emplace_back([&] {
+            WfQueue<int64_t>::Handle h(q);
+            std::vector<int64_t> batch(batch_size, 1);
+            for (int64_t j = 0; j < batch_count; ++j)
+                h.enqueueBulk(batch);
+        });
+        threads.emplace_back([&] {
+            WfQueue<int64_t>::Handle h(q);
+            std::vector<int64_t> batch;
+            while (consumed.load() < pair_count * batch_count * batch_size) {
+                batch.clear();
+                if (auto n = h.dequeueBulk(std::back_inserter(batch), batch_size)) {
+                    sum += std::accumulate(batch.begin(), batch.end(), int64_t{0});
+                    consumed += static_cast<int64_t>(n);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(consumed, pair_count * batch_count * batch_size);
+    ASSERT_EQ(sum, pair_count * batch_count * batch_size);
+}
+
+TEST(WfQueueTest, testDequeueWait) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(h.dequeueWait(10ms));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, 10ms);
+
+    static const int64_t item_count = 10000;
+    std::thread producer([&] {
+        WfQueue<int64_t>::Handle p(q);
+        for (int64_t i = 0; i < item_count; ++i) {
+            if (i % 100 == 0)
+                std::this_thread::sleep_for(100us);
+            p.enqueue(i);
+        }
+    });
+    for (int64_t i = 0; i < item_count; ++i)
+        ASSERT_EQ(h.dequeueWait(10s), i);
+    producer.join();
+}
+
+TEST(WfQueueTest, testDequeueWaitBurnsNoCells) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q;
+    WfQueue<int64_t>::Handle h(q);
+    auto cpu = threadCpuTime();
+    ASSERT_FALSE(h.dequeueWait(50ms));
+    // parked instead of polling
+    ASSERT_LT(threadCpuTime() - cpu, 25ms);
+    h.enqueue(1);
+    ASSERT_EQ(h.dequeue(), 1);
+    auto s = q.stats();
+    ASSERT_EQ(s.neverCells, 0);
+    ASSERT_EQ(s.emptyDequeues, 0);
+    ASSERT_EQ(s.slowEnqueues, 0);
+}
+
+TEST(WfQueueTest, testDequeueWaitForever) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q;
+    std::thread producer([&] {
+        std::this_thread::sleep_for(20ms);
+        WfQueue<int64_t>::Handle p(q);
+        p.enqueue(1);
+    });
+    WfQueue<int64_t>::Handle h(q);
+    ASSERT_EQ(h.dequeueWait(std::chrono::nanoseconds::max()), 1);
+    producer.join();
+}
+
+TEST(WfQueueTest, testDequeueWaitWakesOnePerValue) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q;
+    static const int64_t consumer_count = 4;
+    std::atomic<int64_t> sum = 0;
+    std::vector<std::thread> consumers;
+    for (int64_t i = 0; i < consumer_count; ++i) {
+        consumers.emplace_back([&] {
+            WfQueue<int64_t>::Handle h(q);
+            auto v = h.dequeueWait(10s);
+            ASSERT_TRUE(v);
+            sum += *v;
+        });
+    }
+    // every sleeper is woken by its own value, none is lost.
+    WfQueue<int64_t>::Handle p(q);
+    for (int64_t i = 1; i <= consumer_count; ++i) {
+        std::this_thread::sleep_for(5ms);
+        p.enqueue(i);
+    }
+    for (auto & t : consumers)
+        t.join();
+    ASSERT_EQ(sum, consumer_count * (consumer_count + 1) / 2);
+}
+
+TEST(WfQueueTest, testBounded) {
+    using namespace std::chrono_literals;
+    WfQueue<std::unique_ptr<int>> q(10);
+    WfQueue<std::unique_ptr<int>>::Handle h(q);
+    for (int i = 0; i < 10; ++i)
+        ASSERT_TRUE(h.tryEnqueue(std::make_unique<int>(i)));
+    auto v = std::make_unique<int>(10);
+    ASSERT_FALSE(h.tryEnqueue(std::move(v)));
+    ASSERT_FALSE(h.enqueueWait(std::move(v), 1ms));
+    ASSERT_TRUE(v);
+    ASSERT_EQ(**h.dequeue(), 0);
+    ASSERT_TRUE(h.tryEnqueue(std::move(v)));
+    ASSERT_FALSE(v);
+    for (int i = 1; i <= 10; ++i)
+        ASSERT_EQ(**h.dequeue(), i);
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testBoundedBulk) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q(4);
+    WfQueue<int64_t>::Handle h(q);
+    std::vector<int64_t> values{1, 2, 3, 4, 5};
+    ASSERT_FALSE(h.tryEnqueueBulk(values));
+    ASSERT_TRUE(h.tryEnqueueBulk(std::span(values).first(3)));
+    ASSERT_FALSE(h.tryEnqueueBulk(std::span(values).subspan(3)));
+    ASSERT_FALSE(h.enqueueBulkWait(std::span(values).subspan(3), 1ms));
+    ASSERT_TRUE(h.tryEnqueueBulk(std::span(values).subspan(3, 1)));
+    for (int64_t i = 1; i <= 4; ++i)
+        ASSERT_EQ(h.dequeue(), i);
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testBoundedEnqueueWaits) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q(1);
+    WfQueue<int64_t>::Handle h(q);
+    h.enqueue(0);
+    std::atomic<bool> done = false;
+    std::thread producer([&] {
+        WfQueue<int64_t>::Handle p(q);
+        // neither goes beyond the capacity
+        p.enqueue(1);
+        std::vector<int64_t> values{2};
+        p.enqueueBulk(values);
+        done = true;
+    });
+    for (int64_t i = 0; i < 2; ++i) {
+        std::this_thread::sleep_for(20ms);
+        ASSERT_FALSE(done);
+        ASSERT_EQ(h.dequeueWait(1s), i);
+    }
+    producer.join();
+    ASSERT_EQ(h.dequeue(), 2);
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testBulkSleeperKeepsWakeups) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q(2);
+    WfQueue<int64_t>::Handle h(q);
+    h.enqueue(0);
+    h.enqueue(0);
+    // the bulk sleeper goes first, a place made for one must still reach the other sleeper.
+    std::thread bulk([&] {
+        WfQueue<int64_t>::Handle p(q);
+        std::vector<int64_t> values{2, 2};
+        ASSERT_TRUE(p.enqueueBulkWait(values, 10s));
+    });
+    std::this_thread::sleep_for(20ms);
+    std::thread single([&] {
+        WfQueue<int64_t>::Handle p(q);
+        int64_t v = 1;
+        auto start = std::chrono::steady_clock::now();
+        ASSERT_TRUE(p.enqueueWait(std::move(v), 10s));
+        ASSERT_LT(std::chrono::steady_clock::now() - start, 5s);
+    });
+    std::this_thread::sleep_for(20ms);
+    ASSERT_EQ(h.dequeue(), 0);
+    single.join();
+    int64_t sum = 0;
+    for (int64_t i = 0; i < 4; ++i)
+        sum += *h.dequeueWait(10s);
+    bulk.join();
+    ASSERT_EQ(sum, 5);
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testEnqueueWaitParks) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q(1);
+    WfQueue<int64_t>::Handle h(q);
+    h.enqueue(0);
+    // blocked producers sleep, instead of waking each other by their failed tries.
+    std::vector<std::thread> producers;
+    for (int64_t i = 0; i < 2; ++i) {
+        producers.emplace_back([&] {
+            WfQueue<int64_t>::Handle p(q);
+            auto cpu = threadCpuTime();
+            int64_t v = 1;
+            ASSERT_FALSE(p.enqueueWait(std::move(v), 100ms));
+            ASSERT_LT(threadCpuTime() - cpu, 50ms);
+        });
+    }
+    for (auto & t : producers)
+        t.join();
+    ASSERT_EQ(h.dequeue(), 0);
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testBoundedConcurrent) {
+    using namespace std::chrono_literals;
+    WfQueue<int64_t> q(4);
+    static const int64_t producer_count = 4;
+    static const int64_t item_count = 10000;
+    std::atomic<int64_t> sum = 0;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < producer_count; ++i) {
+        threads.emplace_back([&] {
+            WfQueue<int64_t>::Handle h(q);
+            for (int64_t j = 1; j <= item_count; ++j) {
+                auto v = j;
+                ASSERT_TRUE(h.enqueueWait(std::move(v), 10s));
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        WfQueue<int64_t>::Handle h(q);
+        for (int64_t j = 0; j < producer_count * item_count; ++j) {
+            auto v = h.dequeueWait(10s);
+            ASSERT_TRUE(v);
+            sum += *v;
+        }
+    });
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(sum, producer_count * item_count * (item_count + 1) / 2);
+}
+
+TEST(WfQueueTest, testStats) {
+    WfQueue<int64_t> q;
+    {
+        WfQueue<int64_t>::Handle h(q);
+        for (int64_t i = 0; i < 100; ++i)
+            h.enqueue(i);
+        for (int64_t i = 0; i < 50; ++i)
+            h.dequeue();
+        auto s = h.stats();
+        ASSERT_EQ(s.enqueues, 100);
+        ASSERT_EQ(s.dequeues, 50);
+        ASSERT_EQ(s.slowEnqueues, 0);
+        ASSERT_EQ(s.slowDequeues, 0);
+    }
+    WfQueue<int64_t>::Handle h(q);
+    ASSERT_EQ(h.stats().enqueues, 0);
+    while (h.dequeue()) {
+    }
+    auto s = q.stats();
+    ASSERT_EQ(s.enqueues, 100);
+    ASSERT_EQ(s.dequeues, 100);
+    ASSERT_EQ(s.emptyDequeues, 1);
+    ASSERT_GE(s.neverCells, 1);
+}
+
+TEST(WfQueueTest, testAdaptivePatience) {
+    WfQueue<int64_t, WfQueuePolicy<64, 10, WfCellLayout::PACKED, true>> q;
+    decltype(q)::Handle h(q);
+    ASSERT_EQ(h.patience(), 10);
+    // no contention, no slow path, so patience decreases.
+    for (int64_t i = 0; i < 4096; ++i)
+        h.enqueue(i);
+    ASSERT_LT(h.patience(), 10);
+    for (int64_t i = 0; i < 4096; ++i)
+        ASSERT_EQ(h.dequeue(), i);
+}
+
+TEST(WfQueueTest, testMpsc) {
+    WfMpscQueue<int64_t> q;
+    static const int64_t producer_count = 4;
+    static const int64_t item_count = 100000;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < producer_count; ++i) {
+        threads.emplace_back([&, i] {
+            WfMpscQueue<int64_t>::Handle h(q);
+            for (int64_t j = 0; j < item_count; ++j)
+                h.enqueue(j * producer_count + i);
+        });
+    }
+    // values of each producer keep their order
+    std::vector<int64_t> next(producer_count, 0);
+    WfMpscQueue<int64_t>::Handle h(q);
+    for (int64_t consumed = 0; consumed < producer_count * item_count;) {
+        auto v = h.dequeue();
+        if (!v) {
+            std::this_thread::yield();
+            continue;
+        }
+        auto p = *v % producer_count;
+        ASSERT_EQ(*v / producer_count, next[p]++);
+        ++consumed;
+    }
+    for (auto & t : threads)
+        t.join();
+    ASSERT_FALSE(h.dequeue());
+}
+
+TEST(WfQueueTest, testMpscDequeueWait) {
+    using namespace std::chrono_literals;
+    WfMpscQueue<int64_t> q;
+    static const int64_t producer_count = 4;
+    static const int64_t item_count = 2000;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < producer_count; ++i) {
+        threads.emplace_back([&] {
+            WfMpscQueue<int64_t>::Handle h(q);
+            for (int64_t j = 1; j <= item_count; ++j) {
+                // the consumer often parks, so wakeups race with light fences of enqueuers.
+                if (j % 50 == 0)
+                    std::this_thread::sleep_for(100us);
+                h.enqueue(j);
+            }
+        });
+    }
+    WfMpscQueue<int64_t>::Handle h(q);
+    int64_t sum = 0;
+    for (int64_t i = 0; i < producer_count * item_count; ++i) {
+        auto v = h.dequeueWait(10s);
+        ASSERT_TRUE(v);
+        sum += *v;
+    }
+    for (auto & t : threads)
+        t.join();
+    ASSERT_EQ(sum, producer_count * item_count * (item_count + 1) / 2);
+}
+
+TEST(WfQueueTest, testSpsc) {
+    WfSpscQueue<std::unique_ptr<int64_t>> q;
+    static const int64_t item_count = 100000;
+    std::thread producer([&] {
+        WfSpscQueue<std::unique_ptr<int64_t>>::Handle h(q);
+        std::vector<std::unique_ptr<int64_t>> batch;
+        for (int64_t i = 0; i < item_count;) {
+            if (i % 3 == 0) {
+                h.enqueue(std::make_unique<int64_t>(i++));
+            } else {
+                batch.clear();
+                for (int64_t j = 0; j < 16 && i < item_count; ++j)
+                    batch.push_back(std::make_unique<int64_t>(i++));
+                h.enqueueBulk(batch);
+            }
+        }
+    });
+    WfSpscQueue<std::unique_ptr<int64_t>>::Handle h(q);
+    std::vector<std::unique_ptr<int64_t>> out;
+    for (int64_t i = 0; i < item_count;) {
+        out.clear();
+        if (h.dequeueBulk(std::back_inserter(out), 8) == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (auto & v : out)
+            ASSERT_EQ(*v, i++);
+    }
+    producer.join();
+    ASSERT_FALSE(h.dequeue());
+}
+
+template <typename Policy>
+class WfQueuePolicyTest : public ::testing::Test {};
+
+using WfQueuePolicies = ::testing::Types<
+    WfQueuePolicy<2, 0, WfCellLayout::PACKED>,
+    WfQueuePolicy<16, 1, WfCellLayout::PADDED>,
+    WfQueuePolicy<64, 10, WfCellLayout::SCRAMBLED>,
+    WfQueuePolicy<1024, 100, WfCellLayout::SCRAMBLED>,
+    WfQueuePolicy<64, 0, WfCellLayout::PACKED, true>>;
+TYPED_TEST_SUITE(WfQueuePolicyTest, WfQueuePolicies);
+
+TYPED_TEST(WfQueuePolicyTest, testConcurrent) {
+    WfQueue<int64_t, TypeParam> q;
+    static const int64_t pair_count = 4;
+    static const int64_t item_count = 20000;
+    std::atomic<int64_t> consumed = 0;
+    std::atomic<int64_t> sum = 0;
+
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < pair_count; ++i) {
+        threads.emplace_back([&] {
+            typename WfQueue<int64_t, TypeParam>::Handle h(q);
+            for (int64_t j = 1; j <= item_count; ++j)
+                h.enqueue(j);
+        });
+        threads.emplace_back([&] {
+            typename WfQueue<int64_t, TypeParam>::Handle h(q);
+            while (consumed.load() < pair_count * item_count) {
+                if (auto v = h.dequeue()) {
+                    sum += *v;
+                    ++consumed;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto & t : threads)
+        t.join();
+
+    ASSERT_EQ(consumed, pair_count * item_count);
+    ASSERT_EQ(sum, pair_count * item_count * (item_count + 1) / 2);
+}
+
+} // namespace
+} // namespace camus::tests
@@ -1,3 +1,4 @@
+#include <common/scheduler/FollyExecutor.h>
 #include <folly/Random.h>
 #include <folly/experimental/coro/BlockingWait.h>
 #include <folly/experimental/coro/BoundedQueue.h>
@@ -32,5 +33,12 @@ TEST(FollyCoro, testProducerConsumer) {
         CO_ASSERT_EQ(pcount, ccount);
     }());
 }
+
+TEST(FollyCoro, testSchedulerExecutor) {
+    Scheduler s(2);
+    FollyExecutor ex(s);
+    auto task = [&]() -> folly::coro::Task<bool> { co_return s.inWorker(); };
+    ASSERT_TRUE(folly::coro::blockingWait(task().scheduleOn(folly::getKeepAliveToken(&ex))));
+}
 } // namespace
 } // namespace camus::tests